@@ -0,0 +1,252 @@
+#include "util/map.h"
+#include "util/xmalloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct TreeNode TreeNode;
+struct TreeNode {
+        const void *key;
+        void *value;
+        size_t level;
+        TreeNode *lch;
+        TreeNode *rch;
+};
+
+typedef struct {
+        TreeNode *root;
+        Comparator comparator;
+} TreeMap;
+
+static void tree_skew(TreeNode **rootp) {
+        TreeNode *root = *rootp;
+        if (root == NULL || root->lch == NULL || root->level != root->lch->level) {
+                return;
+        }
+        TreeNode *lch = root->lch;
+        root->lch = lch->rch;
+        lch->rch = root;
+        *rootp = lch;
+}
+
+static void tree_split(TreeNode **rootp) {
+        TreeNode *root = *rootp;
+        if (root == NULL || root->rch == NULL || root->rch->rch == NULL || root->level != root->rch->rch->level) {
+                return;
+        }
+        TreeNode *rch = root->rch;
+        root->rch = rch->lch;
+        rch->lch = root;
+        rch->level++;
+        *rootp = rch;
+}
+
+static void tree_insert(TreeNode **rootp, const void *key, void *value, Comparator comparator) {
+        TreeNode *root = *rootp;
+        if (root == NULL) {
+                root = xmalloc(sizeof(TreeNode));
+                root->key = key;
+                root->value = value;
+                root->level = 1;
+                root->lch = NULL;
+                root->rch = NULL;
+                *rootp = root;
+                return;
+        }
+
+        int c = comparator(key, root->key);
+        if (c < 0) {
+                tree_insert(&root->lch, key, value, comparator);
+        } else if (c > 0) {
+                tree_insert(&root->rch, key, value, comparator);
+        } else {
+                root->value = value;
+        }
+
+        tree_skew(&root);
+        tree_split(&root);
+        *rootp = root;
+}
+
+static TreeNode *tree_search(TreeNode *root, const void *key, Comparator comparator) {
+        while (root != NULL) {
+                int c = comparator(key, root->key);
+                if (c == 0) {
+                        return root;
+                }
+                root = c < 0 ? root->lch : root->rch;
+        }
+        return NULL;
+}
+
+static TreeMap *tree_construct(Comparator comparator) {
+        TreeMap *map = xmalloc(sizeof(TreeMap));
+        map->root = NULL;
+        map->comparator = comparator;
+        return map;
+}
+
+static double now(void) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static char **make_names(size_t num_names, const char *prefix) {
+        char **names = xmalloc(sizeof(char *) * num_names);
+        for (size_t i = 0; i < num_names; i++) {
+                char buffer[64];
+                snprintf(buffer, sizeof(buffer), "%s%zu", prefix, i);
+                names[i] = xstrdup(buffer);
+        }
+        return names;
+}
+
+static volatile size_t sink;
+
+static void report(const char *workload, size_t num_ops, double tree_seconds, double hash_seconds) {
+        double tree_ns = tree_seconds * 1e9 / num_ops;
+        double hash_ns = hash_seconds * 1e9 / num_ops;
+        printf("%-28s %10.2f %10.2f %8.2fx\n", workload, tree_ns, hash_ns, tree_ns / hash_ns);
+}
+
+static void bench_string_keys(const char *workload, size_t num_keys, size_t num_rounds) {
+        char **names = make_names(num_keys, "identifier_");
+        char **probes = make_names(num_keys, "identifier_");
+        size_t num_ops = num_keys * num_rounds;
+
+        double start = now();
+        TreeMap *tree = tree_construct(str_compare);
+        for (size_t i = 0; i < num_keys; i++) {
+                tree_insert(&tree->root, names[i], names[i], tree->comparator);
+        }
+        for (size_t r = 0; r < num_rounds; r++) {
+                for (size_t i = 0; i < num_keys; i++) {
+                        sink += (size_t)tree_search(tree->root, probes[i], tree->comparator)->value;
+                }
+        }
+        double tree_seconds = now() - start;
+
+        start = now();
+        Map *map = map_construct(str_hash, str_compare);
+        for (size_t i = 0; i < num_keys; i++) {
+                map_put(map, names[i], names[i]);
+        }
+        for (size_t r = 0; r < num_rounds; r++) {
+                for (size_t i = 0; i < num_keys; i++) {
+                        sink += (size_t)map_get(map, probes[i]);
+                }
+        }
+        double hash_seconds = now() - start;
+
+        report(workload, num_ops, tree_seconds, hash_seconds);
+}
+
+static void bench_small_maps(size_t num_maps, size_t num_fields, size_t num_rounds) {
+        char **fields = make_names(num_fields, "field_");
+        size_t num_ops = num_maps * num_fields * (num_rounds + 1);
+
+        double start = now();
+        TreeMap **trees = xmalloc(sizeof(TreeMap *) * num_maps);
+        for (size_t m = 0; m < num_maps; m++) {
+                trees[m] = tree_construct(str_compare);
+                for (size_t i = 0; i < num_fields; i++) {
+                        tree_insert(&trees[m]->root, fields[i], (void *)i, str_compare);
+                }
+        }
+        for (size_t r = 0; r < num_rounds; r++) {
+                for (size_t m = 0; m < num_maps; m++) {
+                        for (size_t i = 0; i < num_fields; i++) {
+                                sink += (size_t)tree_search(trees[m]->root, fields[i], str_compare)->value;
+                        }
+                }
+        }
+        double tree_seconds = now() - start;
+
+        start = now();
+        Map **maps = xmalloc(sizeof(Map *) * num_maps);
+        for (size_t m = 0; m < num_maps; m++) {
+                maps[m] = map_construct(str_hash, str_compare);
+                for (size_t i = 0; i < num_fields; i++) {
+                        map_put(maps[m], fields[i], (void *)i);
+                }
+        }
+        for (size_t r = 0; r < num_rounds; r++) {
+                for (size_t m = 0; m < num_maps; m++) {
+                        for (size_t i = 0; i < num_fields; i++) {
+                                sink += (size_t)map_get(maps[m], fields[i]);
+                        }
+                }
+        }
+        double hash_seconds = now() - start;
+
+        report("instance fields (4 keys)", num_ops, tree_seconds, hash_seconds);
+
+        uint64_t *hashes = xmalloc(sizeof(uint64_t) * num_fields);
+        for (size_t i = 0; i < num_fields; i++) {
+                hashes[i] = str_hash(fields[i]);
+        }
+
+        start = now();
+        Map **hashed_maps = xmalloc(sizeof(Map *) * num_maps);
+        for (size_t m = 0; m < num_maps; m++) {
+                hashed_maps[m] = map_construct(str_hash, str_compare);
+                for (size_t i = 0; i < num_fields; i++) {
+                        map_put_hashed(hashed_maps[m], fields[i], hashes[i], (void *)i);
+                }
+        }
+        for (size_t r = 0; r < num_rounds; r++) {
+                for (size_t m = 0; m < num_maps; m++) {
+                        for (size_t i = 0; i < num_fields; i++) {
+                                sink += (size_t)map_get_hashed(hashed_maps[m], fields[i], hashes[i]);
+                        }
+                }
+        }
+        hash_seconds = now() - start;
+
+        report("instance fields (prehashed)", num_ops, tree_seconds, hash_seconds);
+}
+
+static void bench_pointer_keys(size_t num_keys, size_t num_rounds) {
+        void **keys = xmalloc(sizeof(void *) * num_keys);
+        for (size_t i = 0; i < num_keys; i++) {
+                keys[i] = xmalloc(32);
+        }
+        size_t num_ops = num_keys * (num_rounds + 1);
+
+        double start = now();
+        TreeMap *tree = tree_construct(ptr_compare);
+        for (size_t i = 0; i < num_keys; i++) {
+                tree_insert(&tree->root, keys[i], (void *)i, ptr_compare);
+        }
+        for (size_t r = 0; r < num_rounds; r++) {
+                for (size_t i = 0; i < num_keys; i++) {
+                        sink += (size_t)tree_search(tree->root, keys[i], ptr_compare)->value;
+                }
+        }
+        double tree_seconds = now() - start;
+
+        start = now();
+        Map *map = map_construct(ptr_hash, ptr_compare);
+        for (size_t i = 0; i < num_keys; i++) {
+                map_put(map, keys[i], (void *)i);
+        }
+        for (size_t r = 0; r < num_rounds; r++) {
+                for (size_t i = 0; i < num_keys; i++) {
+                        sink += (size_t)map_get(map, keys[i]);
+                }
+        }
+        double hash_seconds = now() - start;
+
+        report("pointer keys (100k)", num_ops, tree_seconds, hash_seconds);
+}
+
+int main(void) {
+        printf("%-28s %10s %10s %9s\n", "workload", "tree ns/op", "hash ns/op", "speedup");
+        bench_string_keys("globals (64 names)", 64, 200000);
+        bench_string_keys("globals (4096 names)", 4096, 2000);
+        bench_small_maps(100000, 4, 20);
+        bench_pointer_keys(100000, 50);
+        return EXIT_SUCCESS;
+}
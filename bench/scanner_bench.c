@@ -0,0 +1,166 @@
+#include "lox/scanner_simd.h"
+#include "util/xmalloc.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now(void) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static volatile size_t sink;
+
+static char *make_runs(size_t num_runs, const char *run, char terminator) {
+        size_t run_length = strlen(run);
+        char *source = xmalloc(num_runs * (run_length + 1) + 1);
+        char *p = source;
+        for (size_t i = 0; i < num_runs; i++) {
+                memcpy(p, run, run_length);
+                p += run_length;
+                *p++ = terminator;
+        }
+        *p = '\0';
+        return source;
+}
+
+static void report(const char *workload, size_t num_bytes, double scalar_seconds, double simd_seconds) {
+        double scalar_rate = num_bytes / scalar_seconds / 1e6;
+        double simd_rate = num_bytes / simd_seconds / 1e6;
+        printf("%-28s %10.0f %10.0f %8.2fx\n", workload, scalar_rate, simd_rate, simd_rate / scalar_rate);
+}
+
+static void bench_whitespace(const char *workload, const char *run, size_t num_runs, size_t num_rounds) {
+        char *source = make_runs(num_runs, run, ';');
+        size_t num_bytes = strlen(source) * num_rounds;
+
+        double start = now();
+        for (size_t r = 0; r < num_rounds; r++) {
+                size_t line = 1;
+                for (const char *p = source; *p != '\0'; p++) {
+                        while (isspace(*p)) {
+                                if (*p++ == '\n') {
+                                        line++;
+                                }
+                        }
+                }
+                sink += line;
+        }
+        double scalar_seconds = now() - start;
+
+        start = now();
+        for (size_t r = 0; r < num_rounds; r++) {
+                size_t line = 1;
+                for (const char *p = source; *p != '\0'; p++) {
+                        p = skip_whitespace(p, &line);
+                }
+                sink += line;
+        }
+        double simd_seconds = now() - start;
+
+        report(workload, num_bytes, scalar_seconds, simd_seconds);
+        free(source);
+}
+
+static void bench_comments(size_t num_runs, size_t num_rounds) {
+        char *source = make_runs(num_runs, "// computes the running total of every element seen so far", '\n');
+        size_t num_bytes = strlen(source) * num_rounds;
+
+        double start = now();
+        for (size_t r = 0; r < num_rounds; r++) {
+                for (const char *p = source; *p != '\0'; p++) {
+                        while (*p != '\0' && *p != '\n') {
+                                p++;
+                        }
+                        sink += *p;
+                }
+        }
+        double scalar_seconds = now() - start;
+
+        start = now();
+        for (size_t r = 0; r < num_rounds; r++) {
+                for (const char *p = source; *p != '\0'; p++) {
+                        p = skip_comment(p);
+                        sink += *p;
+                }
+        }
+        double simd_seconds = now() - start;
+
+        report("comments (60 bytes)", num_bytes, scalar_seconds, simd_seconds);
+        free(source);
+}
+
+static void bench_strings(size_t num_runs, size_t num_rounds) {
+        char *source = make_runs(num_runs, "the quick brown fox jumps over the lazy dog", '\"');
+        size_t num_bytes = strlen(source) * num_rounds;
+
+        double start = now();
+        for (size_t r = 0; r < num_rounds; r++) {
+                size_t line = 1;
+                for (const char *p = source; *p != '\0'; p++) {
+                        while (*p != '\0' && *p != '\"') {
+                                if (*p++ == '\n') {
+                                        line++;
+                                }
+                        }
+                }
+                sink += line;
+        }
+        double scalar_seconds = now() - start;
+
+        start = now();
+        for (size_t r = 0; r < num_rounds; r++) {
+                size_t line = 1;
+                for (const char *p = source; *p != '\0'; p++) {
+                        p = skip_string(p, &line);
+                }
+                sink += line;
+        }
+        double simd_seconds = now() - start;
+
+        report("strings (43 bytes)", num_bytes, scalar_seconds, simd_seconds);
+        free(source);
+}
+
+static void bench_identifiers(const char *workload, const char *run, size_t num_runs, size_t num_rounds) {
+        char *source = make_runs(num_runs, run, '.');
+        size_t num_bytes = strlen(source) * num_rounds;
+
+        double start = now();
+        for (size_t r = 0; r < num_rounds; r++) {
+                for (const char *p = source; *p != '\0'; p++) {
+                        while (*p == '_' || isalnum(*p)) {
+                                p++;
+                        }
+                        sink += *p;
+                }
+        }
+        double scalar_seconds = now() - start;
+
+        start = now();
+        for (size_t r = 0; r < num_rounds; r++) {
+                for (const char *p = source; *p != '\0'; p++) {
+                        p = skip_identifier(p);
+                        sink += *p;
+                }
+        }
+        double simd_seconds = now() - start;
+
+        report(workload, num_bytes, scalar_seconds, simd_seconds);
+        free(source);
+}
+
+int main(void) {
+        printf("%-28s %10s %10s %9s\n", "workload", "byte MB/s", "simd MB/s", "speedup");
+        bench_whitespace("whitespace (1 byte)", " ", 1000000, 20);
+        bench_whitespace("indentation (17 bytes)", "\n                ", 1000000, 20);
+        bench_comments(200000, 20);
+        bench_strings(200000, 20);
+        bench_identifiers("identifiers (5 bytes)", "count", 1000000, 20);
+        bench_identifiers("identifiers (24 bytes)", "number_of_pending_events", 400000, 20);
+        return EXIT_SUCCESS;
+}
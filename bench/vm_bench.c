@@ -0,0 +1,185 @@
+#include <err.h>
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NUM_ROUNDS 5
+
+typedef struct {
+        const char *name;
+        const char *source;
+} Workload;
+
+static const Workload workloads[] = {
+        {
+                "fib",
+                "fun fib(n) { if (n < 2) return n; return fib(n - 1) + fib(n - 2); }\n"
+                "print fib(30);\n",
+        },
+        {
+                "loop arithmetic",
+                "var sum = 0;\n"
+                "for (var i = 0; i < 3000000; i = i + 1) { sum = sum + i * 2 - i / 2; }\n"
+                "print sum;\n",
+        },
+        {
+                "method calls",
+                "class Counter { init() { this.n = 0; } bump(k) { this.n = this.n + k; return this; } }\n"
+                "var c = Counter();\n"
+                "for (var i = 0; i < 1000000; i = i + 1) { c.bump(1).bump(-1).bump(1); }\n"
+                "print c.n;\n",
+        },
+        {
+                "closures",
+                "fun counter() { var n = 0; fun inc() { n = n + 1; return n; } return inc; }\n"
+                "var inc = counter();\n"
+                "var last = 0;\n"
+                "for (var i = 0; i < 2000000; i = i + 1) { last = inc(); }\n"
+                "print last;\n",
+        },
+};
+
+typedef struct {
+        double seconds;
+        uint64_t instructions;
+        uint64_t cycles;
+        bool has_counters;
+} Sample;
+
+static double now(void) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int open_counter(pid_t pid, uint64_t config) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.enable_on_exec = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+}
+
+static uint64_t read_counter(int fd) {
+        uint64_t value = 0;
+        if (read(fd, &value, sizeof(value)) != sizeof(value)) {
+                return 0;
+        }
+        return value;
+}
+
+static Sample run_once(const char *interpreter, const char *path) {
+        int ready[2];
+        if (pipe(ready) < 0) {
+                err(EXIT_FAILURE, "pipe");
+        }
+
+        double start = now();
+        pid_t pid = fork();
+        if (pid < 0) {
+                err(EXIT_FAILURE, "fork");
+        } else if (pid == 0) {
+                close(ready[1]);
+                char byte;
+                if (read(ready[0], &byte, 1) != 1) {
+                        _exit(EXIT_FAILURE);
+                }
+                int null = open("/dev/null", O_WRONLY);
+                dup2(null, STDOUT_FILENO);
+                execl(interpreter, interpreter, "run", "--vm", "--no-jit", path, (char *)NULL);
+                _exit(127);
+        }
+
+        close(ready[0]);
+        int instructions_fd = open_counter(pid, PERF_COUNT_HW_INSTRUCTIONS);
+        int cycles_fd = open_counter(pid, PERF_COUNT_HW_CPU_CYCLES);
+        if (write(ready[1], "", 1) != 1) {
+                err(EXIT_FAILURE, "write");
+        }
+        close(ready[1]);
+
+        int status;
+        if (waitpid(pid, &status, 0) < 0) {
+                err(EXIT_FAILURE, "waitpid");
+        }
+        Sample sample = {.seconds = now() - start};
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                errx(EXIT_FAILURE, "%s exited abnormally", interpreter);
+        }
+
+        if (instructions_fd >= 0 && cycles_fd >= 0) {
+                sample.instructions = read_counter(instructions_fd);
+                sample.cycles = read_counter(cycles_fd);
+                sample.has_counters = sample.cycles > 0;
+        }
+        if (instructions_fd >= 0) {
+                close(instructions_fd);
+        }
+        if (cycles_fd >= 0) {
+                close(cycles_fd);
+        }
+        return sample;
+}
+
+static Sample run_best(const char *interpreter, const char *path) {
+        Sample best = run_once(interpreter, path);
+        for (size_t i = 1; i < NUM_ROUNDS; i++) {
+                Sample sample = run_once(interpreter, path);
+                if (sample.seconds < best.seconds) {
+                        best = sample;
+                }
+        }
+        return best;
+}
+
+static void report(const char *workload, const char *dispatch, Sample sample) {
+        if (sample.has_counters) {
+                printf("%-16s %-9s %8.3f %14llu %14llu %6.2f\n", workload, dispatch, sample.seconds,
+                       (unsigned long long)sample.instructions, (unsigned long long)sample.cycles,
+                       (double)sample.instructions / sample.cycles);
+        } else {
+                printf("%-16s %-9s %8.3f %14s %14s %6s\n", workload, dispatch, sample.seconds, "n/a", "n/a", "n/a");
+        }
+}
+
+static void write_workload(const Workload *workload, char *path) {
+        int fd = mkstemps(path, strlen(".lox"));
+        if (fd < 0) {
+                err(EXIT_FAILURE, "mkstemps");
+        }
+        size_t length = strlen(workload->source);
+        if (write(fd, workload->source, length) != (ssize_t)length) {
+                err(EXIT_FAILURE, "%s", path);
+        }
+        close(fd);
+}
+
+int main(int argc, char *argv[]) {
+        const char *threaded = argc > 1 ? argv[1] : THREADED_INTERPRETER;
+        const char *switched = argc > 2 ? argv[2] : SWITCH_INTERPRETER;
+
+        printf("%-16s %-9s %8s %14s %14s %6s\n", "workload", "dispatch", "seconds", "instructions", "cycles", "IPC");
+        for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+                char path[] = "/tmp/vm_bench_XXXXXX.lox";
+                write_workload(&workloads[i], path);
+                Sample switch_sample = run_best(switched, path);
+                Sample threaded_sample = run_best(threaded, path);
+                report(workloads[i].name, "switch", switch_sample);
+                report(workloads[i].name, "threaded", threaded_sample);
+                printf("%-16s %-9s %7.2fx\n", workloads[i].name, "speedup", switch_sample.seconds / threaded_sample.seconds);
+                unlink(path);
+        }
+}
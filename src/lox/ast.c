@@ -0,0 +1,103 @@
+#include "lox/ast.h"
+#include "util/xmalloc.h"
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#define RESERVED_WORDS ((size_t)1 << 29)
+#define COMMIT_WORDS ((size_t)1 << 16)
+
+AstPool ast_pool;
+
+static struct {
+        size_t size;
+        size_t committed;
+        size_t num_nodes;
+        size_t num_lists;
+        AstRef *scratch;
+        size_t scratch_size;
+        size_t scratch_capacity;
+} ast;
+
+static void reserve(void) {
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+        void *nodes = mmap(NULL, RESERVED_WORDS * sizeof(uint64_t), PROT_NONE, flags, -1, 0);
+        if (nodes == MAP_FAILED) {
+                err(EXIT_FAILURE, "mmap");
+        }
+        ast_pool.nodes = nodes;
+        ast.size = AST_NULL + 1;
+}
+
+static void commit(size_t size) {
+        size_t committed = (size + COMMIT_WORDS - 1) / COMMIT_WORDS * COMMIT_WORDS;
+        if (committed > RESERVED_WORDS) {
+                errx(EXIT_FAILURE, "syntax tree too large");
+        }
+        uint64_t *start = ast_pool.nodes + ast.committed;
+        if (mprotect(start, (committed - ast.committed) * sizeof(uint64_t), PROT_READ | PROT_WRITE) < 0) {
+                err(EXIT_FAILURE, "mprotect");
+        }
+        ast.committed = committed;
+}
+
+static AstRef take(size_t num_words) {
+        if (ast_pool.nodes == NULL) {
+                reserve();
+        }
+        size_t start = ast.size;
+        if (start + num_words > ast.committed) {
+                commit(start + num_words);
+        }
+        ast.size += num_words;
+        return start;
+}
+
+void *ast_allocate(size_t size) {
+        ast.num_nodes++;
+        return ast_node(take((size + sizeof(uint64_t) - 1) / sizeof(uint64_t)));
+}
+
+AstRef ast_ref(const void *node) {
+        if (node == NULL) {
+                return AST_NULL;
+        }
+        return (const uint64_t *)node - ast_pool.nodes;
+}
+
+size_t ast_list_begin(void) {
+        return ast.scratch_size;
+}
+
+void ast_list_push(AstRef ref) {
+        if (ast.scratch_size == ast.scratch_capacity) {
+                ast.scratch_capacity = ast.scratch_capacity == 0 ? 64 : ast.scratch_capacity * 2;
+                ast.scratch = xrealloc(ast.scratch, sizeof(AstRef) * ast.scratch_capacity);
+        }
+        ast.scratch[ast.scratch_size++] = ref;
+}
+
+AstList ast_list_end(size_t mark) {
+        size_t size = ast.scratch_size - mark;
+        AstList list = {.start = take((sizeof(AstRef) * size + sizeof(uint64_t) - 1) / sizeof(uint64_t)), .size = size};
+        AstRef *refs = ast_node(list.start);
+        for (size_t i = 0; i < size; i++) {
+                refs[i] = ast.scratch[mark + i];
+        }
+        ast.scratch_size = mark;
+        ast.num_lists++;
+        return list;
+}
+
+static void report_stats(void) {
+        fprintf(stderr, "[ast] nodes: %zu\n", ast.num_nodes);
+        fprintf(stderr, "[ast] lists: %zu\n", ast.num_lists);
+        fprintf(stderr, "[ast] bytes used: %zu\n", ast.size * sizeof(uint64_t));
+        fprintf(stderr, "[ast] bytes committed: %zu\n", ast.committed * sizeof(uint64_t));
+}
+
+void ast_enable_stats(void) {
+        atexit(report_stats);
+}
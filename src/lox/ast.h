@@ -0,0 +1,39 @@
+#ifndef CODECRAFTERS_INTERPRETER_LOX_AST_H
+#define CODECRAFTERS_INTERPRETER_LOX_AST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define AST_NULL 0
+
+typedef uint32_t AstRef;
+
+typedef struct {
+        AstRef start;
+        uint32_t size;
+} AstList;
+
+typedef struct {
+        uint64_t *nodes;
+} AstPool;
+
+extern AstPool ast_pool;
+
+void *ast_allocate(size_t size);
+AstRef ast_ref(const void *node);
+
+size_t ast_list_begin(void);
+void ast_list_push(AstRef ref);
+AstList ast_list_end(size_t mark);
+
+void ast_enable_stats(void);
+
+static inline void *ast_node(AstRef ref) {
+        return ast_pool.nodes + ref;
+}
+
+static inline const AstRef *ast_refs(AstList list) {
+        return (const AstRef *)(ast_pool.nodes + list.start);
+}
+
+#endif
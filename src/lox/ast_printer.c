@@ -1,24 +1,55 @@
 #include "lox/ast_printer.h"
+#include "lox/ast.h"
 #include "lox/expr.h"
 #include "lox/object.h"
+#include "lox/token.h"
 
 #include <err.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+static const char *operator_to_string(TokenType operator) {
+        switch (operator) {
+        case TOKEN_BANG:
+                return "!";
+        case TOKEN_BANG_EQUAL:
+                return "!=";
+        case TOKEN_EQUAL_EQUAL:
+                return "==";
+        case TOKEN_GREATER:
+                return ">";
+        case TOKEN_GREATER_EQUAL:
+                return ">=";
+        case TOKEN_LESS:
+                return "<";
+        case TOKEN_LESS_EQUAL:
+                return "<=";
+        case TOKEN_MINUS:
+                return "-";
+        case TOKEN_PLUS:
+                return "+";
+        case TOKEN_SLASH:
+                return "/";
+        case TOKEN_STAR:
+                return "*";
+        default:
+                errx(EXIT_FAILURE, "unexpected operator");
+        }
+}
+
 static void print_expr(const Expr *expr);
 
 static void print_binary_expr(const BinaryExpr *binary_expr) {
-        printf("(%s ", binary_expr->operator->lexeme);
-        print_expr(binary_expr->left);
+        printf("(%s ", operator_to_string(binary_expr->base.operator));
+        print_expr(ast_node(binary_expr->left));
         printf(" ");
-        print_expr(binary_expr->right);
+        print_expr(ast_node(binary_expr->right));
         printf(")");
 }
 
 static void print_grouping_expr(const GroupingExpr *grouping_expr) {
         printf("(group ");
-        print_expr(grouping_expr->expression);
+        print_expr(ast_node(grouping_expr->expression));
         printf(")");
 }
 
@@ -27,8 +58,8 @@ static void print_literal_expr(const LiteralExpr *literal_expr) {
 }
 
 static void print_unary_expr(const UnaryExpr *unary_expr) {
-        printf("(%s ", unary_expr->operator->lexeme);
-        print_expr(unary_expr->right);
+        printf("(%s ", operator_to_string(unary_expr->base.operator));
+        print_expr(ast_node(unary_expr->right));
         printf(")");
 }
 
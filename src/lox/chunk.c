@@ -0,0 +1,61 @@
+#include "lox/chunk.h"
+#include "lox/object.h"
+#include "util/vector.h"
+#include "util/xmalloc.h"
+
+Prototype *prototype_construct(const char *name, size_t arity) {
+        Prototype *prototype = xmalloc(sizeof(Prototype));
+        prototype->name = name;
+        prototype->arity = arity;
+        prototype->num_upvalues = 0;
+        prototype->max_stack = 0;
+        prototype->hotness = 0;
+        prototype->jit_code = NULL;
+
+        const size_t initial_capacity = 64;
+        prototype->chunk.code = xmalloc(sizeof(uint8_t) * initial_capacity);
+        prototype->chunk.lines = xmalloc(sizeof(size_t) * initial_capacity);
+        prototype->chunk.size = 0;
+        prototype->chunk.capacity = initial_capacity;
+        prototype->chunk.constants = vector_construct();
+        prototype->chunk.prototypes = vector_construct();
+        return prototype;
+}
+
+void chunk_write(Chunk *chunk, uint8_t byte, size_t line) {
+        if (chunk->size == chunk->capacity) {
+                size_t new_capacity = chunk->capacity * 2;
+                chunk->code = xrealloc(chunk->code, sizeof(uint8_t) * new_capacity);
+                chunk->lines = xrealloc(chunk->lines, sizeof(size_t) * new_capacity);
+                chunk->capacity = new_capacity;
+        }
+        chunk->code[chunk->size] = byte;
+        chunk->lines[chunk->size] = line;
+        chunk->size++;
+}
+
+void chunk_write_u16(Chunk *chunk, uint16_t value, size_t line) {
+        chunk_write(chunk, value & 0xff, line);
+        chunk_write(chunk, value >> 8, line);
+}
+
+void chunk_write_u32(Chunk *chunk, uint32_t value, size_t line) {
+        chunk_write_u16(chunk, value & 0xffff, line);
+        chunk_write_u16(chunk, value >> 16, line);
+}
+
+void chunk_patch_u32(Chunk *chunk, size_t offset, uint32_t value) {
+        for (size_t i = 0; i < 4; i++) {
+                chunk->code[offset + i] = (value >> (8 * i)) & 0xff;
+        }
+}
+
+size_t chunk_add_constant(Chunk *chunk, Object *constant) {
+        vector_push_back(chunk->constants, constant);
+        return vector_size(chunk->constants) - 1;
+}
+
+size_t chunk_add_prototype(Chunk *chunk, Prototype *prototype) {
+        vector_push_back(chunk->prototypes, prototype);
+        return vector_size(chunk->prototypes) - 1;
+}
@@ -0,0 +1,84 @@
+#ifndef CODECRAFTERS_INTERPRETER_LOX_CHUNK_H
+#define CODECRAFTERS_INTERPRETER_LOX_CHUNK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lox/object.h"
+#include "util/vector.h"
+
+typedef enum {
+        OP_ADD,
+        OP_CALL,
+        OP_CHECK_INSTANCE,
+        OP_CLASS,
+        OP_CLOSE_UPVALUE,
+        OP_CLOSURE,
+        OP_CONSTANT,
+        OP_DEFINE_GLOBAL,
+        OP_DIVIDE,
+        OP_EQUAL,
+        OP_FALSE,
+        OP_GET_GLOBAL,
+        OP_GET_LOCAL,
+        OP_GET_PROPERTY,
+        OP_GET_SUPER,
+        OP_GET_UPVALUE,
+        OP_GREATER,
+        OP_GREATER_EQUAL,
+        OP_INHERIT,
+        OP_JUMP,
+        OP_JUMP_IF_FALSE,
+        OP_JUMP_IF_TRUE,
+        OP_LESS,
+        OP_LESS_EQUAL,
+        OP_LOOP,
+        OP_METHOD,
+        OP_MULTIPLY,
+        OP_NEGATE,
+        OP_NIL,
+        OP_NOT,
+        OP_NOT_EQUAL,
+        OP_POP,
+        OP_POP_JUMP_IF_FALSE,
+        OP_PRINT,
+        OP_RETURN,
+        OP_SET_GLOBAL,
+        OP_SET_LOCAL,
+        OP_SET_PROPERTY,
+        OP_SET_UPVALUE,
+        OP_SUBTRACT,
+        OP_TRUE,
+} OpCode;
+
+typedef struct {
+        uint8_t *code;
+        size_t *lines;
+        size_t size;
+        size_t capacity;
+        Vector *constants;
+        Vector *prototypes;
+} Chunk;
+
+typedef struct JitCode JitCode;
+
+typedef struct {
+        const char *name;
+        size_t arity;
+        size_t num_upvalues;
+        size_t max_stack;
+        Chunk chunk;
+        size_t hotness;
+        JitCode *jit_code;
+} Prototype;
+
+Prototype *prototype_construct(const char *name, size_t arity);
+
+void chunk_write(Chunk *chunk, uint8_t byte, size_t line);
+void chunk_write_u16(Chunk *chunk, uint16_t value, size_t line);
+void chunk_write_u32(Chunk *chunk, uint32_t value, size_t line);
+void chunk_patch_u32(Chunk *chunk, size_t offset, uint32_t value);
+size_t chunk_add_constant(Chunk *chunk, Object *constant);
+size_t chunk_add_prototype(Chunk *chunk, Prototype *prototype);
+
+#endif
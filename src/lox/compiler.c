@@ -0,0 +1,666 @@
+#include "lox/compiler.h"
+#include "lox/ast.h"
+#include "lox/chunk.h"
+#include "lox/expr.h"
+#include "lox/object.h"
+#include "lox/stmt.h"
+#include "lox/token.h"
+#include "util/intern.h"
+#include "util/map.h"
+#include "util/xmalloc.h"
+
+#include <err.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+        FUNCTION_FUNCTION,
+        FUNCTION_INITIALIZER,
+        FUNCTION_METHOD,
+        FUNCTION_SCRIPT,
+} FunctionType;
+
+typedef struct {
+        const char *name;
+        size_t depth;
+        bool is_captured;
+} Local;
+
+typedef struct {
+        uint16_t index;
+        bool is_local;
+} UpvalueInfo;
+
+typedef struct FunctionCompiler FunctionCompiler;
+struct FunctionCompiler {
+        FunctionCompiler *enclosing;
+        Prototype *prototype;
+        FunctionType type;
+        Local *locals;
+        size_t num_locals;
+        size_t locals_capacity;
+        UpvalueInfo *upvalues;
+        size_t upvalues_capacity;
+        Map *identifiers;
+        size_t scope_depth;
+        ptrdiff_t stack_depth;
+};
+
+static struct {
+        FunctionCompiler *current;
+        size_t line;
+} compiler;
+
+static const int stack_effects[] = {
+        [OP_ADD] = -1,
+        [OP_CALL] = 0,
+        [OP_CHECK_INSTANCE] = 0,
+        [OP_CLASS] = 1,
+        [OP_CLOSE_UPVALUE] = -1,
+        [OP_CLOSURE] = 1,
+        [OP_CONSTANT] = 1,
+        [OP_DEFINE_GLOBAL] = -1,
+        [OP_DIVIDE] = -1,
+        [OP_EQUAL] = -1,
+        [OP_FALSE] = 1,
+        [OP_GET_GLOBAL] = 1,
+        [OP_GET_LOCAL] = 1,
+        [OP_GET_PROPERTY] = 0,
+        [OP_GET_SUPER] = -1,
+        [OP_GET_UPVALUE] = 1,
+        [OP_GREATER] = -1,
+        [OP_GREATER_EQUAL] = -1,
+        [OP_INHERIT] = -1,
+        [OP_JUMP] = 0,
+        [OP_JUMP_IF_FALSE] = 0,
+        [OP_JUMP_IF_TRUE] = 0,
+        [OP_LESS] = -1,
+        [OP_LESS_EQUAL] = -1,
+        [OP_LOOP] = 0,
+        [OP_METHOD] = -1,
+        [OP_MULTIPLY] = -1,
+        [OP_NEGATE] = 0,
+        [OP_NIL] = 1,
+        [OP_NOT] = 0,
+        [OP_NOT_EQUAL] = -1,
+        [OP_POP] = -1,
+        [OP_POP_JUMP_IF_FALSE] = -1,
+        [OP_PRINT] = -1,
+        [OP_RETURN] = -1,
+        [OP_SET_GLOBAL] = 0,
+        [OP_SET_LOCAL] = 0,
+        [OP_SET_PROPERTY] = -1,
+        [OP_SET_UPVALUE] = 0,
+        [OP_SUBTRACT] = -1,
+        [OP_TRUE] = 1,
+};
+
+static Chunk *current_chunk(void) {
+        return &compiler.current->prototype->chunk;
+}
+
+static void mark(size_t line) {
+        compiler.line = line;
+}
+
+static void adjust_stack(ptrdiff_t delta) {
+        FunctionCompiler *current = compiler.current;
+        current->stack_depth += delta;
+        if (current->stack_depth > (ptrdiff_t)current->prototype->max_stack) {
+                current->prototype->max_stack = current->stack_depth;
+        }
+}
+
+static void emit_byte(uint8_t byte) {
+        chunk_write(current_chunk(), byte, compiler.line);
+}
+
+static void emit_u16(size_t value) {
+        if (value > UINT16_MAX) {
+                errx(EXIT_FAILURE, "too many local variables in function");
+        }
+        chunk_write_u16(current_chunk(), value, compiler.line);
+}
+
+static void emit_u32(size_t value) {
+        if (value > UINT32_MAX) {
+                errx(EXIT_FAILURE, "too many constants in one chunk");
+        }
+        chunk_write_u32(current_chunk(), value, compiler.line);
+}
+
+static void emit_op(OpCode op) {
+        emit_byte(op);
+        adjust_stack(stack_effects[op]);
+}
+
+static void emit_op_u16(OpCode op, size_t operand) {
+        emit_op(op);
+        emit_u16(operand);
+}
+
+static void emit_op_u32(OpCode op, size_t operand) {
+        emit_op(op);
+        emit_u32(operand);
+}
+
+static size_t emit_jump(OpCode op) {
+        emit_op(op);
+        size_t offset = current_chunk()->size;
+        emit_u32(0);
+        return offset;
+}
+
+static void patch_jump(size_t offset) {
+        Chunk *chunk = current_chunk();
+        chunk_patch_u32(chunk, offset, chunk->size - offset - 4);
+}
+
+static void emit_loop(size_t loop_start) {
+        emit_op(OP_LOOP);
+        emit_u32(current_chunk()->size - loop_start + 4);
+}
+
+static void emit_constant(Object *value) {
+        emit_op_u32(OP_CONSTANT, chunk_add_constant(current_chunk(), value));
+}
+
+static size_t identifier_constant(const char *name) {
+        Map *identifiers = compiler.current->identifiers;
+        void *value;
+        if (map_find(identifiers, name, &value)) {
+                return (size_t)value;
+        }
+        size_t index = chunk_add_constant(current_chunk(), string_object_construct(name));
+        map_put(identifiers, name, (void *)index);
+        return index;
+}
+
+static void emit_return(void) {
+        if (compiler.current->type == FUNCTION_INITIALIZER) {
+                emit_op_u16(OP_GET_LOCAL, 0);
+        } else {
+                emit_op(OP_NIL);
+        }
+        emit_op(OP_RETURN);
+}
+
+static void add_local(const char *name) {
+        FunctionCompiler *current = compiler.current;
+        if (current->num_locals == current->locals_capacity) {
+                current->locals_capacity *= 2;
+                current->locals = xrealloc(current->locals, sizeof(Local) * current->locals_capacity);
+        }
+        Local *local = &current->locals[current->num_locals++];
+        local->name = name;
+        local->depth = current->scope_depth;
+        local->is_captured = false;
+}
+
+static void begin_function(FunctionCompiler *function_compiler, FunctionType type, const char *name, size_t arity) {
+        function_compiler->enclosing = compiler.current;
+        function_compiler->prototype = prototype_construct(name, arity);
+        function_compiler->type = type;
+
+        const size_t initial_capacity = 16;
+        function_compiler->locals = xmalloc(sizeof(Local) * initial_capacity);
+        function_compiler->num_locals = 0;
+        function_compiler->locals_capacity = initial_capacity;
+        function_compiler->upvalues = xmalloc(sizeof(UpvalueInfo) * initial_capacity);
+        function_compiler->upvalues_capacity = initial_capacity;
+        function_compiler->identifiers = map_construct(ptr_hash, ptr_compare);
+        function_compiler->scope_depth = 0;
+        function_compiler->stack_depth = 0;
+
+        compiler.current = function_compiler;
+        add_local(intern_string(type == FUNCTION_FUNCTION || type == FUNCTION_SCRIPT ? "" : "this"));
+        adjust_stack(1);
+}
+
+static Prototype *end_function(void) {
+        emit_return();
+        FunctionCompiler *current = compiler.current;
+        compiler.current = current->enclosing;
+        free(current->locals);
+        map_destruct(current->identifiers);
+        return current->prototype;
+}
+
+static void begin_scope(void) {
+        compiler.current->scope_depth++;
+}
+
+static void end_scope(void) {
+        FunctionCompiler *current = compiler.current;
+        current->scope_depth--;
+        while (current->num_locals > 0 && current->locals[current->num_locals - 1].depth > current->scope_depth) {
+                if (current->locals[current->num_locals - 1].is_captured) {
+                        emit_op(OP_CLOSE_UPVALUE);
+                } else {
+                        emit_op(OP_POP);
+                }
+                current->num_locals--;
+        }
+}
+
+static bool resolve_local(const FunctionCompiler *function_compiler, const char *name, size_t *slot) {
+        for (size_t i = function_compiler->num_locals; i > 0; i--) {
+                if (function_compiler->locals[i - 1].name == name) {
+                        *slot = i - 1;
+                        return true;
+                }
+        }
+        return false;
+}
+
+static size_t add_upvalue(FunctionCompiler *function_compiler, size_t index, bool is_local) {
+        Prototype *prototype = function_compiler->prototype;
+        for (size_t i = 0; i < prototype->num_upvalues; i++) {
+                UpvalueInfo *upvalue = &function_compiler->upvalues[i];
+                if (upvalue->index == index && upvalue->is_local == is_local) {
+                        return i;
+                }
+        }
+
+        if (index > UINT16_MAX || prototype->num_upvalues == UINT16_MAX) {
+                errx(EXIT_FAILURE, "too many closure variables in function");
+        }
+        if (prototype->num_upvalues == function_compiler->upvalues_capacity) {
+                function_compiler->upvalues_capacity *= 2;
+                size_t size = sizeof(UpvalueInfo) * function_compiler->upvalues_capacity;
+                function_compiler->upvalues = xrealloc(function_compiler->upvalues, size);
+        }
+        function_compiler->upvalues[prototype->num_upvalues].index = index;
+        function_compiler->upvalues[prototype->num_upvalues].is_local = is_local;
+        return prototype->num_upvalues++;
+}
+
+static bool resolve_upvalue(FunctionCompiler *function_compiler, const char *name, size_t *index) {
+        FunctionCompiler *enclosing = function_compiler->enclosing;
+        if (enclosing == NULL) {
+                return false;
+        }
+
+        size_t slot;
+        if (resolve_local(enclosing, name, &slot)) {
+                enclosing->locals[slot].is_captured = true;
+                *index = add_upvalue(function_compiler, slot, true);
+                return true;
+        }
+        if (resolve_upvalue(enclosing, name, &slot)) {
+                *index = add_upvalue(function_compiler, slot, false);
+                return true;
+        }
+        return false;
+}
+
+static void named_variable(const char *name, size_t line, bool is_assignment) {
+        mark(line);
+        size_t index;
+        if (resolve_local(compiler.current, name, &index)) {
+                emit_op_u16(is_assignment ? OP_SET_LOCAL : OP_GET_LOCAL, index);
+        } else if (resolve_upvalue(compiler.current, name, &index)) {
+                emit_op_u16(is_assignment ? OP_SET_UPVALUE : OP_GET_UPVALUE, index);
+        } else {
+                emit_op_u32(is_assignment ? OP_SET_GLOBAL : OP_GET_GLOBAL, identifier_constant(name));
+        }
+}
+
+static void define_variable(const char *name, size_t line) {
+        if (compiler.current->scope_depth > 0) {
+                add_local(name);
+                return;
+        }
+        mark(line);
+        emit_op_u32(OP_DEFINE_GLOBAL, identifier_constant(name));
+}
+
+static void compile_expr(const Expr *expr);
+static void compile_stmt(const Stmt *stmt);
+
+static void compile_block(AstList statements) {
+        const AstRef *refs = ast_refs(statements);
+        for (size_t i = 0; i < statements.size; i++) {
+                compile_stmt(ast_node(refs[i]));
+        }
+}
+
+static void compile_function(const FunctionStmt *function, FunctionType type) {
+        FunctionCompiler function_compiler;
+        size_t num_params = function->params.size;
+        begin_function(&function_compiler, type, function->name, num_params);
+        begin_scope();
+        const AstRef *params = ast_refs(function->params);
+        for (size_t i = 0; i < num_params; i++) {
+                add_local(((const VariableExpr *)ast_node(params[i]))->name);
+        }
+        adjust_stack(num_params);
+        compile_block(function->body);
+        Prototype *prototype = end_function();
+
+        mark(function->base.line);
+        emit_op_u32(OP_CLOSURE, chunk_add_prototype(current_chunk(), prototype));
+        for (size_t i = 0; i < prototype->num_upvalues; i++) {
+                emit_byte(function_compiler.upvalues[i].is_local);
+                emit_u16(function_compiler.upvalues[i].index);
+        }
+        free(function_compiler.upvalues);
+}
+
+static void compile_assign_expr(const AssignExpr *assign_expr) {
+        compile_expr(ast_node(assign_expr->value));
+        named_variable(assign_expr->name, assign_expr->base.line, true);
+}
+
+static void compile_binary_expr(const BinaryExpr *binary_expr) {
+        compile_expr(ast_node(binary_expr->left));
+        compile_expr(ast_node(binary_expr->right));
+        mark(binary_expr->base.line);
+        switch (binary_expr->base.operator) {
+        case TOKEN_BANG_EQUAL:
+                emit_op(OP_NOT_EQUAL);
+                break;
+        case TOKEN_EQUAL_EQUAL:
+                emit_op(OP_EQUAL);
+                break;
+        case TOKEN_GREATER:
+                emit_op(OP_GREATER);
+                break;
+        case TOKEN_GREATER_EQUAL:
+                emit_op(OP_GREATER_EQUAL);
+                break;
+        case TOKEN_LESS:
+                emit_op(OP_LESS);
+                break;
+        case TOKEN_LESS_EQUAL:
+                emit_op(OP_LESS_EQUAL);
+                break;
+        case TOKEN_MINUS:
+                emit_op(OP_SUBTRACT);
+                break;
+        case TOKEN_PLUS:
+                emit_op(OP_ADD);
+                break;
+        case TOKEN_SLASH:
+                emit_op(OP_DIVIDE);
+                break;
+        case TOKEN_STAR:
+                emit_op(OP_MULTIPLY);
+                break;
+        default:
+                errx(EXIT_FAILURE, "unexpected operator");
+        }
+}
+
+static void compile_call_expr(const CallExpr *call_expr) {
+        compile_expr(ast_node(call_expr->callee));
+        const AstRef *arguments = ast_refs(call_expr->arguments);
+        size_t num_arguments = call_expr->arguments.size;
+        for (size_t i = 0; i < num_arguments; i++) {
+                compile_expr(ast_node(arguments[i]));
+        }
+        mark(call_expr->base.line);
+        emit_op(OP_CALL);
+        emit_byte(num_arguments);
+        adjust_stack(-(ptrdiff_t)num_arguments);
+}
+
+static void compile_get_expr(const GetExpr *get_expr) {
+        compile_expr(ast_node(get_expr->object));
+        mark(get_expr->base.line);
+        emit_op_u32(OP_GET_PROPERTY, identifier_constant(get_expr->name));
+}
+
+static void compile_grouping_expr(const GroupingExpr *grouping_expr) {
+        compile_expr(ast_node(grouping_expr->expression));
+}
+
+static void compile_literal_expr(const LiteralExpr *literal_expr) {
+        Object *value = literal_expr->value;
+        if (value == nil_object_construct()) {
+                emit_op(OP_NIL);
+        } else if (value == boolean_object_construct(true)) {
+                emit_op(OP_TRUE);
+        } else if (value == boolean_object_construct(false)) {
+                emit_op(OP_FALSE);
+        } else {
+                emit_constant(value);
+        }
+}
+
+static void compile_logical_expr(const LogicalExpr *logical_expr) {
+        compile_expr(ast_node(logical_expr->left));
+        mark(logical_expr->base.line);
+        size_t end_jump = emit_jump(logical_expr->base.operator == TOKEN_AND ? OP_JUMP_IF_FALSE : OP_JUMP_IF_TRUE);
+        emit_op(OP_POP);
+        compile_expr(ast_node(logical_expr->right));
+        patch_jump(end_jump);
+}
+
+static void compile_set_expr(const SetExpr *set_expr) {
+        const Expr *object = ast_node(set_expr->object);
+        compile_expr(object);
+        mark(set_expr->base.line);
+        if (object->type != EXPR_THIS) {
+                emit_op(OP_CHECK_INSTANCE);
+        }
+        compile_expr(ast_node(set_expr->value));
+        mark(set_expr->base.line);
+        emit_op_u32(OP_SET_PROPERTY, identifier_constant(set_expr->name));
+}
+
+static void compile_super_expr(const SuperExpr *super_expr) {
+        named_variable(intern_string("this"), super_expr->base.line, false);
+        named_variable(intern_string("super"), super_expr->base.line, false);
+        mark(super_expr->method_line);
+        emit_op_u32(OP_GET_SUPER, identifier_constant(super_expr->method));
+}
+
+static void compile_this_expr(const ThisExpr *this_expr) {
+        named_variable(intern_string("this"), this_expr->base.line, false);
+}
+
+static void compile_unary_expr(const UnaryExpr *unary_expr) {
+        compile_expr(ast_node(unary_expr->right));
+        mark(unary_expr->base.line);
+        switch (unary_expr->base.operator) {
+        case TOKEN_BANG:
+                emit_op(OP_NOT);
+                break;
+        case TOKEN_MINUS:
+                emit_op(OP_NEGATE);
+                break;
+        default:
+                errx(EXIT_FAILURE, "unexpected operator");
+        }
+}
+
+static void compile_variable_expr(const VariableExpr *variable_expr) {
+        named_variable(variable_expr->name, variable_expr->base.line, false);
+}
+
+static void compile_expr(const Expr *expr) {
+        switch (expr->type) {
+        case EXPR_ASSIGN:
+                compile_assign_expr((const AssignExpr *)expr);
+                break;
+        case EXPR_BINARY:
+                compile_binary_expr((const BinaryExpr *)expr);
+                break;
+        case EXPR_CALL:
+                compile_call_expr((const CallExpr *)expr);
+                break;
+        case EXPR_GET:
+                compile_get_expr((const GetExpr *)expr);
+                break;
+        case EXPR_GROUPING:
+                compile_grouping_expr((const GroupingExpr *)expr);
+                break;
+        case EXPR_LITERAL:
+                compile_literal_expr((const LiteralExpr *)expr);
+                break;
+        case EXPR_LOGICAL:
+                compile_logical_expr((const LogicalExpr *)expr);
+                break;
+        case EXPR_SET:
+                compile_set_expr((const SetExpr *)expr);
+                break;
+        case EXPR_SUPER:
+                compile_super_expr((const SuperExpr *)expr);
+                break;
+        case EXPR_THIS:
+                compile_this_expr((const ThisExpr *)expr);
+                break;
+        case EXPR_UNARY:
+                compile_unary_expr((const UnaryExpr *)expr);
+                break;
+        case EXPR_VARIABLE:
+                compile_variable_expr((const VariableExpr *)expr);
+                break;
+        }
+}
+
+static void compile_block_stmt(const BlockStmt *block_stmt) {
+        begin_scope();
+        compile_block(block_stmt->statements);
+        end_scope();
+}
+
+static void compile_class_stmt(const ClassStmt *class_stmt) {
+        const char *name = class_stmt->name;
+        size_t line = class_stmt->base.line;
+        mark(line);
+        emit_op_u32(OP_CLASS, identifier_constant(name));
+        define_variable(name, line);
+
+        if (class_stmt->superclass != AST_NULL) {
+                const VariableExpr *superclass = ast_node(class_stmt->superclass);
+                compile_variable_expr(superclass);
+                begin_scope();
+                add_local(intern_string("super"));
+                named_variable(name, line, false);
+                mark(superclass->base.line);
+                emit_op(OP_INHERIT);
+        }
+
+        named_variable(name, line, false);
+        const AstRef *methods = ast_refs(class_stmt->methods);
+        for (size_t i = 0; i < class_stmt->methods.size; i++) {
+                const FunctionStmt *method = ast_node(methods[i]);
+                bool is_initializer = strcmp(method->name, "init") == 0;
+                compile_function(method, is_initializer ? FUNCTION_INITIALIZER : FUNCTION_METHOD);
+                emit_op_u32(OP_METHOD, identifier_constant(method->name));
+        }
+        emit_op(OP_POP);
+
+        if (class_stmt->superclass != AST_NULL) {
+                end_scope();
+        }
+}
+
+static void compile_expression_stmt(const ExpressionStmt *expression_stmt) {
+        compile_expr(ast_node(expression_stmt->expression));
+        emit_op(OP_POP);
+}
+
+static void compile_function_stmt(const FunctionStmt *function_stmt) {
+        if (compiler.current->scope_depth > 0) {
+                add_local(function_stmt->name);
+                compile_function(function_stmt, FUNCTION_FUNCTION);
+                return;
+        }
+        compile_function(function_stmt, FUNCTION_FUNCTION);
+        define_variable(function_stmt->name, function_stmt->base.line);
+}
+
+static void compile_if_stmt(const IfStmt *if_stmt) {
+        compile_expr(ast_node(if_stmt->condition));
+        size_t else_jump = emit_jump(OP_POP_JUMP_IF_FALSE);
+        compile_stmt(ast_node(if_stmt->then_branch));
+        if (if_stmt->else_branch == AST_NULL) {
+                patch_jump(else_jump);
+                return;
+        }
+        size_t end_jump = emit_jump(OP_JUMP);
+        patch_jump(else_jump);
+        compile_stmt(ast_node(if_stmt->else_branch));
+        patch_jump(end_jump);
+}
+
+static void compile_print_stmt(const PrintStmt *print_stmt) {
+        compile_expr(ast_node(print_stmt->expression));
+        emit_op(OP_PRINT);
+}
+
+static void compile_return_stmt(const ReturnStmt *return_stmt) {
+        mark(return_stmt->base.line);
+        if (return_stmt->value == AST_NULL) {
+                emit_return();
+                return;
+        }
+        compile_expr(ast_node(return_stmt->value));
+        emit_op(OP_RETURN);
+}
+
+static void compile_var_stmt(const VarStmt *var_stmt) {
+        if (var_stmt->initializer == AST_NULL) {
+                emit_op(OP_NIL);
+        } else {
+                compile_expr(ast_node(var_stmt->initializer));
+        }
+        define_variable(var_stmt->name, var_stmt->base.line);
+}
+
+static void compile_while_stmt(const WhileStmt *while_stmt) {
+        size_t loop_start = current_chunk()->size;
+        compile_expr(ast_node(while_stmt->condition));
+        size_t exit_jump = emit_jump(OP_POP_JUMP_IF_FALSE);
+        compile_stmt(ast_node(while_stmt->body));
+        emit_loop(loop_start);
+        patch_jump(exit_jump);
+}
+
+static void compile_stmt(const Stmt *stmt) {
+        switch (stmt->type) {
+        case STMT_BLOCK:
+                compile_block_stmt((const BlockStmt *)stmt);
+                break;
+        case STMT_CLASS:
+                compile_class_stmt((const ClassStmt *)stmt);
+                break;
+        case STMT_EXPRESSION:
+                compile_expression_stmt((const ExpressionStmt *)stmt);
+                break;
+        case STMT_FUNCTION:
+                compile_function_stmt((const FunctionStmt *)stmt);
+                break;
+        case STMT_IF:
+                compile_if_stmt((const IfStmt *)stmt);
+                break;
+        case STMT_PRINT:
+                compile_print_stmt((const PrintStmt *)stmt);
+                break;
+        case STMT_RETURN:
+                compile_return_stmt((const ReturnStmt *)stmt);
+                break;
+        case STMT_VAR:
+                compile_var_stmt((const VarStmt *)stmt);
+                break;
+        case STMT_WHILE:
+                compile_while_stmt((const WhileStmt *)stmt);
+                break;
+        }
+}
+
+Prototype *compile_stmts(AstList statements) {
+        FunctionCompiler function_compiler;
+        compiler.line = 1;
+        compiler.current = NULL;
+        begin_function(&function_compiler, FUNCTION_SCRIPT, "script", 0);
+        compile_block(statements);
+        Prototype *prototype = end_function();
+        free(function_compiler.upvalues);
+        return prototype;
+}
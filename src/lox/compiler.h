@@ -0,0 +1,9 @@
+#ifndef CODECRAFTERS_INTERPRETER_LOX_COMPILER_H
+#define CODECRAFTERS_INTERPRETER_LOX_COMPILER_H
+
+#include "lox/ast.h"
+#include "lox/chunk.h"
+
+Prototype *compile_stmts(AstList statements);
+
+#endif
@@ -1,27 +1,29 @@
 #include "lox/environment.h"
 #include "lox/errors.h"
+#include "lox/gc.h"
 #include "lox/object.h"
-#include "lox/token.h"
 #include "util/map.h"
-#include "util/xmalloc.h"
 
+#include <assert.h>
 #include <string.h>
 
-Environment *environment_construct(Environment *enclosing) {
-        Environment *environment = xmalloc(sizeof(Environment));
-        environment->values = map_construct(str_compare);
+Environment *environment_construct(Environment *enclosing, size_t num_slots) {
+        Environment *environment = gc_allocate(GC_ENVIRONMENT, sizeof(Environment) + sizeof(Object *) * num_slots);
+        environment->values = enclosing == NULL ? map_construct(ptr_hash, ptr_compare) : NULL;
         environment->enclosing = enclosing;
+        environment->num_slots = num_slots;
+        for (size_t i = 0; i < num_slots; i++) {
+                environment->slots[i] = NULL;
+        }
         return environment;
 }
 
-Object *environment_get(const Environment *environment, const Token *name) {
-        if (map_contains(environment->values, name->lexeme)) {
-                return map_get(environment->values, name->lexeme);
-        }
-        if (environment->enclosing != NULL) {
-                return environment_get(environment->enclosing, name);
+Object *environment_get(const Environment *environment, const char *name, size_t line) {
+        void *value;
+        if (map_find(environment->values, name, &value)) {
+                return value;
         }
-        interpret_error(name, "Undefined variable '%s'.", name->lexeme);
+        interpret_error(line, "Undefined variable '%s'.", name);
 }
 
 static Environment *ancestor(const Environment *environment, size_t depth) {
@@ -32,27 +34,29 @@ static Environment *ancestor(const Environment *environment, size_t depth) {
         return p;
 }
 
-Object *environment_get_at(const Environment *environment, const char *name, size_t depth) {
+Object *environment_get_at(const Environment *environment, size_t depth, size_t slot) {
         Environment *env = ancestor(environment, depth);
-        return map_get(env->values, name);
+        assert(slot < env->num_slots);
+        return env->slots[slot];
 }
 
 void environment_define(Environment *environment, const char *name, Object *value) {
         map_put(environment->values, name, value);
 }
 
-void environment_assign(Environment *environment, const Token *name, Object *value) {
-        if (map_contains(environment->values, name->lexeme)) {
-                map_put(environment->values, name->lexeme, value);
-                return;
-        }
-        if (environment->enclosing != NULL) {
-                environment_assign(environment->enclosing, name, value);
+void environment_define_at(Environment *environment, size_t slot, Object *value) {
+        assert(slot < environment->num_slots);
+        environment->slots[slot] = value;
+}
+
+void environment_assign(Environment *environment, const char *name, size_t line, Object *value) {
+        if (map_contains(environment->values, name)) {
+                map_put(environment->values, name, value);
                 return;
         }
-        interpret_error(name, "Undefined variable '%s'.", name->lexeme);
+        interpret_error(line, "Undefined variable '%s'.", name);
 }
 
-void environment_assign_at(Environment *environment, const Token *name, Object *value, size_t depth) {
-        environment_assign(ancestor(environment, depth), name, value);
+void environment_assign_at(Environment *environment, size_t depth, size_t slot, Object *value) {
+        environment_define_at(ancestor(environment, depth), slot, value);
 }
@@ -20,7 +20,7 @@ void parse_error(const Token *token, const char *format, ...) {
         if (token->type == TOKEN_EOF) {
                 fprintf(stderr, "end: ");
         } else {
-                fprintf(stderr, "'%s': ", token->lexeme);
+                fprintf(stderr, "'%.*s': ", (int)token->length, token->lexeme);
         }
         va_list ap;
         va_start(ap, format);
@@ -31,11 +31,32 @@ void parse_error(const Token *token, const char *format, ...) {
 }
 
 __attribute__((noreturn))
-void interpret_error(const Token *token, const char *format, ...) {
+void resolve_error(size_t line, const char *lexeme, const char *format, ...) {
+        fprintf(stderr, "[line %zu] Error at '%s': ", line, lexeme);
         va_list ap;
         va_start(ap, format);
         vfprintf(stderr, format, ap);
         va_end(ap);
-        fprintf(stderr, "\n[line %zu]\n", token->line);
+        fprintf(stderr, "\n");
+        exit(65);
+}
+
+__attribute__((noreturn))
+void interpret_error(size_t line, const char *format, ...) {
+        va_list ap;
+        va_start(ap, format);
+        vfprintf(stderr, format, ap);
+        va_end(ap);
+        fprintf(stderr, "\n[line %zu]\n", line);
+        exit(70);
+}
+
+__attribute__((noreturn))
+void vm_error(size_t line, const char *format, ...) {
+        va_list ap;
+        va_start(ap, format);
+        vfprintf(stderr, format, ap);
+        va_end(ap);
+        fprintf(stderr, "\n[line %zu]\n", line);
         exit(70);
 }
@@ -1,98 +1,107 @@
 #include "lox/expr.h"
-#include "util/xmalloc.h"
+#include "lox/ast.h"
+#include "lox/inline_cache.h"
 
-AssignExpr *assign_expr_construct(Token *name, Expr *value) {
-        AssignExpr *assign_expr = xmalloc(sizeof(AssignExpr));
-        assign_expr->base.type = EXPR_ASSIGN;
+static VariableLocation unresolved_location(void) {
+        VariableLocation location = {.is_local = false, .depth = 0, .slot = 0};
+        return location;
+}
+
+static void *expr_allocate(size_t size, ExprType type, size_t line) {
+        Expr *expr = ast_allocate(size);
+        expr->type = type;
+        expr->operator = TOKEN_EOF;
+        expr->handler = 0;
+        expr->line = line;
+        return expr;
+}
+
+AssignExpr *assign_expr_construct(const char *name, size_t line, Expr *value) {
+        AssignExpr *assign_expr = expr_allocate(sizeof(AssignExpr), EXPR_ASSIGN, line);
         assign_expr->name = name;
-        assign_expr->value = value;
+        assign_expr->value = ast_ref(value);
+        assign_expr->location = unresolved_location();
         return assign_expr;
 }
 
-BinaryExpr *binary_expr_construct(Expr *left, Token *operator, Expr *right) {
-        BinaryExpr *binary_expr = xmalloc(sizeof(BinaryExpr));
-        binary_expr->base.type = EXPR_BINARY;
-        binary_expr->left = left;
-        binary_expr->operator = operator;
-        binary_expr->right = right;
+BinaryExpr *binary_expr_construct(Expr *left, const Token *operator, Expr *right) {
+        BinaryExpr *binary_expr = expr_allocate(sizeof(BinaryExpr), EXPR_BINARY, operator->line);
+        binary_expr->base.operator = operator->type;
+        binary_expr->left = ast_ref(left);
+        binary_expr->right = ast_ref(right);
         return binary_expr;
 }
 
-CallExpr *call_expr_construct(Expr *callee, Token *paren, Vector *arguments) {
-        CallExpr *call_expr = xmalloc(sizeof(CallExpr));
-        call_expr->base.type = EXPR_CALL;
-        call_expr->callee = callee;
-        call_expr->paren = paren;
+CallExpr *call_expr_construct(Expr *callee, size_t line, AstList arguments) {
+        CallExpr *call_expr = expr_allocate(sizeof(CallExpr), EXPR_CALL, line);
+        call_expr->callee = ast_ref(callee);
         call_expr->arguments = arguments;
         return call_expr;
 }
 
-GetExpr *get_expr_construct(Expr *object, Token *name) {
-        GetExpr *get_expr = xmalloc(sizeof(GetExpr));
-        get_expr->base.type = EXPR_GET;
-        get_expr->object = object;
+GetExpr *get_expr_construct(Expr *object, const char *name, size_t line) {
+        GetExpr *get_expr = expr_allocate(sizeof(GetExpr), EXPR_GET, line);
+        get_expr->object = ast_ref(object);
         get_expr->name = name;
+        get_expr->field_cache = inline_cache_construct();
+        get_expr->method_cache = inline_cache_construct();
         return get_expr;
 }
 
 GroupingExpr *grouping_expr_construct(Expr *expression) {
-        GroupingExpr *grouping_expr = xmalloc(sizeof(GroupingExpr));
-        grouping_expr->base.type = EXPR_GROUPING;
-        grouping_expr->expression = expression;
+        GroupingExpr *grouping_expr = expr_allocate(sizeof(GroupingExpr), EXPR_GROUPING, expression->line);
+        grouping_expr->expression = ast_ref(expression);
         return grouping_expr;
 }
 
 LiteralExpr *literal_expr_construct(Object *value) {
-        LiteralExpr *literal_expr = xmalloc(sizeof(LiteralExpr));
-        literal_expr->base.type = EXPR_LITERAL;
+        LiteralExpr *literal_expr = expr_allocate(sizeof(LiteralExpr), EXPR_LITERAL, 0);
         literal_expr->value = value;
         return literal_expr;
 }
 
-LogicalExpr *logical_expr_construct(Expr *left, Token *operator, Expr *right) {
-        LogicalExpr *logical_expr = xmalloc(sizeof(LogicalExpr));
-        logical_expr->base.type = EXPR_LOGICAL;
-        logical_expr->left = left;
-        logical_expr->operator = operator;
-        logical_expr->right = right;
+LogicalExpr *logical_expr_construct(Expr *left, const Token *operator, Expr *right) {
+        LogicalExpr *logical_expr = expr_allocate(sizeof(LogicalExpr), EXPR_LOGICAL, operator->line);
+        logical_expr->base.operator = operator->type;
+        logical_expr->left = ast_ref(left);
+        logical_expr->right = ast_ref(right);
         return logical_expr;
 }
 
-SetExpr *set_expr_construct(Expr *object, Token *name, Expr *value) {
-        SetExpr *set_expr = xmalloc(sizeof(SetExpr));
-        set_expr->base.type = EXPR_SET;
-        set_expr->object = object;
+SetExpr *set_expr_construct(Expr *object, const char *name, size_t line, Expr *value) {
+        SetExpr *set_expr = expr_allocate(sizeof(SetExpr), EXPR_SET, line);
+        set_expr->object = ast_ref(object);
         set_expr->name = name;
-        set_expr->value = value;
+        set_expr->value = ast_ref(value);
+        set_expr->cache = inline_cache_construct();
         return set_expr;
 }
 
-SuperExpr *super_expr_construct(Token *keyword, Token *method) {
-        SuperExpr *super_expr = xmalloc(sizeof(SuperExpr));
-        super_expr->base.type = EXPR_SUPER;
-        super_expr->keyword = keyword;
+SuperExpr *super_expr_construct(size_t line, const char *method, size_t method_line) {
+        SuperExpr *super_expr = expr_allocate(sizeof(SuperExpr), EXPR_SUPER, line);
         super_expr->method = method;
+        super_expr->method_line = method_line;
+        super_expr->location = unresolved_location();
+        super_expr->this_location = unresolved_location();
         return super_expr;
 }
 
-ThisExpr *this_expr_construct(Token *keyword) {
-        ThisExpr *this_expr = xmalloc(sizeof(ThisExpr));
-        this_expr->base.type = EXPR_THIS;
-        this_expr->keyword = keyword;
+ThisExpr *this_expr_construct(size_t line) {
+        ThisExpr *this_expr = expr_allocate(sizeof(ThisExpr), EXPR_THIS, line);
+        this_expr->location = unresolved_location();
         return this_expr;
 }
 
-UnaryExpr *unary_expr_construct(Token *operator, Expr *right) {
-        UnaryExpr *unary_expr = xmalloc(sizeof(UnaryExpr));
-        unary_expr->base.type = EXPR_UNARY;
-        unary_expr->operator = operator;
-        unary_expr->right = right;
+UnaryExpr *unary_expr_construct(const Token *operator, Expr *right) {
+        UnaryExpr *unary_expr = expr_allocate(sizeof(UnaryExpr), EXPR_UNARY, operator->line);
+        unary_expr->base.operator = operator->type;
+        unary_expr->right = ast_ref(right);
         return unary_expr;
 }
 
-VariableExpr *variable_expr_construct(Token *name) {
-        VariableExpr *variable_expr = xmalloc(sizeof(VariableExpr));
-        variable_expr->base.type = EXPR_VARIABLE;
+VariableExpr *variable_expr_construct(const char *name, size_t line) {
+        VariableExpr *variable_expr = expr_allocate(sizeof(VariableExpr), EXPR_VARIABLE, line);
         variable_expr->name = name;
+        variable_expr->location = unresolved_location();
         return variable_expr;
 }
@@ -1,9 +1,14 @@
 #ifndef CODECRAFTERS_INTERPRETER_LOX_EXPR_H
 #define CODECRAFTERS_INTERPRETER_LOX_EXPR_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lox/ast.h"
+#include "lox/inline_cache.h"
 #include "lox/token.h"
 #include "lox/object.h"
-#include "util/vector.h"
 
 typedef enum {
         EXPR_ASSIGN,
@@ -21,46 +26,56 @@ typedef enum {
 } ExprType;
 
 typedef struct {
-        ExprType type;
+        ExprType type : 8;
+        TokenType operator : 8;
+        uint8_t handler;
+        uint32_t line;
 } Expr;
 
+typedef struct {
+        bool is_local : 1;
+        uint32_t depth : 31;
+        uint32_t slot;
+} VariableLocation;
+
 typedef struct {
         Expr base;
-        Token *name;
-        Expr *value;
+        const char *name;
+        VariableLocation location;
+        AstRef value;
 } AssignExpr;
 
-AssignExpr *assign_expr_construct(Token *name, Expr *value);
+AssignExpr *assign_expr_construct(const char *name, size_t line, Expr *value);
 
 typedef struct {
         Expr base;
-        Expr *left;
-        Token *operator;
-        Expr *right;
+        AstRef left;
+        AstRef right;
 } BinaryExpr;
 
-BinaryExpr *binary_expr_construct(Expr *left, Token *operator, Expr *right);
+BinaryExpr *binary_expr_construct(Expr *left, const Token *operator, Expr *right);
 
 typedef struct {
         Expr base;
-        Expr *callee;
-        Token *paren;
-        Vector *arguments;
+        AstRef callee;
+        AstList arguments;
 } CallExpr;
 
-CallExpr *call_expr_construct(Expr *callee, Token *paren, Vector *arguments);
+CallExpr *call_expr_construct(Expr *callee, size_t line, AstList arguments);
 
 typedef struct {
         Expr base;
-        Expr *object;
-        Token *name;
+        AstRef object;
+        const char *name;
+        InlineCache *field_cache;
+        InlineCache *method_cache;
 } GetExpr;
 
-GetExpr *get_expr_construct(Expr *object, Token *name);
+GetExpr *get_expr_construct(Expr *object, const char *name, size_t line);
 
 typedef struct {
         Expr base;
-        Expr *expression;
+        AstRef expression;
 } GroupingExpr;
 
 GroupingExpr *grouping_expr_construct(Expr *expression);
@@ -74,50 +89,52 @@ LiteralExpr *literal_expr_construct(Object *value);
 
 typedef struct {
         Expr base;
-        Expr *left;
-        Token *operator;
-        Expr *right;
+        AstRef left;
+        AstRef right;
 } LogicalExpr;
 
-LogicalExpr *logical_expr_construct(Expr *left, Token *operator, Expr *right);
+LogicalExpr *logical_expr_construct(Expr *left, const Token *operator, Expr *right);
 
 typedef struct {
         Expr base;
-        Expr *object;
-        Token *name;
-        Expr *value;
+        AstRef object;
+        AstRef value;
+        const char *name;
+        InlineCache *cache;
 } SetExpr;
 
-SetExpr *set_expr_construct(Expr *object, Token *name, Expr *value);
+SetExpr *set_expr_construct(Expr *object, const char *name, size_t line, Expr *value);
 
 typedef struct {
         Expr base;
-        Token *keyword;
-        Token *method;
+        const char *method;
+        VariableLocation location;
+        VariableLocation this_location;
+        uint32_t method_line;
 } SuperExpr;
 
-SuperExpr *super_expr_construct(Token *keyword, Token *method);
+SuperExpr *super_expr_construct(size_t line, const char *method, size_t method_line);
 
 typedef struct {
         Expr base;
-        Token *keyword;
+        VariableLocation location;
 } ThisExpr;
 
-ThisExpr *this_expr_construct(Token *keyword);
+ThisExpr *this_expr_construct(size_t line);
 
 typedef struct {
         Expr base;
-        Token *operator;
-        Expr *right;
+        AstRef right;
 } UnaryExpr;
 
-UnaryExpr *unary_expr_construct(Token *operator, Expr *right);
+UnaryExpr *unary_expr_construct(const Token *operator, Expr *right);
 
 typedef struct {
         Expr base;
-        Token *name;
+        const char *name;
+        VariableLocation location;
 } VariableExpr;
 
-VariableExpr *variable_expr_construct(Token *name);
+VariableExpr *variable_expr_construct(const char *name, size_t line);
 
 #endif
@@ -0,0 +1,276 @@
+#include "lox/gc.h"
+#include "lox/environment.h"
+#include "lox/lox_callable.h"
+#include "lox/lox_class.h"
+#include "lox/lox_closure.h"
+#include "lox/lox_function.h"
+#include "lox/lox_instance.h"
+#include "lox/object.h"
+#include "util/map.h"
+#include "util/xmalloc.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct Header Header;
+struct Header {
+        Header *next;
+        size_t size;
+        GcType type;
+        bool is_marked;
+};
+
+#define MIN_NEXT_COLLECTION (1 << 20)
+
+static struct {
+        Header *objects;
+        RootMarker mark_roots;
+        bool is_enabled;
+        double growth_factor;
+        size_t bytes_allocated;
+        size_t next_collection;
+        Header **gray;
+        size_t num_gray;
+        size_t gray_capacity;
+        const void **roots;
+        size_t num_roots;
+        size_t roots_capacity;
+        size_t class_epoch;
+        size_t num_collections;
+        size_t total_allocated;
+        size_t total_reclaimed;
+        double total_pause;
+        double max_pause;
+} gc = {
+        .growth_factor = 2.0,
+        .next_collection = MIN_NEXT_COLLECTION,
+};
+
+static Header *header_of(const void *pointer) {
+        return (Header *)pointer - 1;
+}
+
+void *gc_allocate(GcType type, size_t size) {
+        if (!gc.is_enabled) {
+                return gc_allocate_permanent(size);
+        }
+
+        Header *header = xmalloc(sizeof(Header) + size);
+        header->next = gc.objects;
+        header->size = sizeof(Header) + size;
+        header->type = type;
+        header->is_marked = false;
+        gc.objects = header;
+        gc.bytes_allocated += header->size;
+        gc.total_allocated += header->size;
+        return header + 1;
+}
+
+void *gc_allocate_permanent(size_t size) {
+        Header *header = xmalloc(sizeof(Header) + size);
+        header->next = NULL;
+        header->size = sizeof(Header) + size;
+        header->is_marked = true;
+        return header + 1;
+}
+
+void gc_enable(RootMarker mark_roots) {
+        gc.mark_roots = mark_roots;
+        gc.is_enabled = true;
+}
+
+static void report_stats(void) {
+        fprintf(stderr, "[gc] collections: %zu\n", gc.num_collections);
+        fprintf(stderr, "[gc] bytes allocated: %zu\n", gc.total_allocated);
+        fprintf(stderr, "[gc] bytes reclaimed: %zu\n", gc.total_reclaimed);
+        fprintf(stderr, "[gc] bytes live: %zu\n", gc.bytes_allocated);
+        fprintf(stderr, "[gc] pause total: %.3lf ms, max: %.3lf ms\n", gc.total_pause * 1e3, gc.max_pause * 1e3);
+}
+
+void gc_enable_stats(void) {
+        atexit(report_stats);
+}
+
+void gc_set_growth_factor(double growth_factor) {
+        gc.growth_factor = growth_factor;
+}
+
+void gc_mark(const void *pointer) {
+        if (pointer == NULL || object_is_immediate(pointer)) {
+                return;
+        }
+        Header *header = header_of(pointer);
+        if (header->is_marked) {
+                return;
+        }
+        header->is_marked = true;
+
+        if (gc.num_gray == gc.gray_capacity) {
+                gc.gray_capacity = gc.gray_capacity == 0 ? 64 : gc.gray_capacity * 2;
+                gc.gray = xrealloc(gc.gray, sizeof(Header *) * gc.gray_capacity);
+        }
+        gc.gray[gc.num_gray++] = header;
+}
+
+static void mark_value(const void *key, void *value) {
+        (void)key;
+        gc_mark(value);
+}
+
+void gc_mark_values(const Map *map) {
+        map_for_each(map, mark_value);
+}
+
+void gc_push_root(const void *pointer) {
+        if (gc.num_roots == gc.roots_capacity) {
+                gc.roots_capacity = gc.roots_capacity == 0 ? 64 : gc.roots_capacity * 2;
+                gc.roots = xrealloc(gc.roots, sizeof(const void *) * gc.roots_capacity);
+        }
+        gc.roots[gc.num_roots++] = pointer;
+}
+
+void gc_pop_roots(size_t num_roots) {
+        gc.num_roots -= num_roots;
+}
+
+static void blacken(Header *header) {
+        void *pointer = header + 1;
+        switch (header->type) {
+        case GC_BOUND_METHOD: {
+                LoxBoundMethod *bound_method = pointer;
+                gc_mark(bound_method->receiver);
+                gc_mark(bound_method->method);
+                break;
+        }
+        case GC_CLASS: {
+                LoxClass *class = pointer;
+                gc_mark(class->superclass);
+                gc_mark_values(class->methods);
+                break;
+        }
+        case GC_CLOSURE: {
+                LoxClosure *closure = pointer;
+                for (size_t i = 0; i < closure->prototype->num_upvalues; i++) {
+                        gc_mark(closure->upvalues[i]);
+                }
+                break;
+        }
+        case GC_ENVIRONMENT: {
+                Environment *environment = pointer;
+                gc_mark(environment->enclosing);
+                for (size_t i = 0; i < environment->num_slots; i++) {
+                        gc_mark(environment->slots[i]);
+                }
+                if (environment->values != NULL) {
+                        gc_mark_values(environment->values);
+                }
+                break;
+        }
+        case GC_FUNCTION: {
+                LoxFunction *function = pointer;
+                gc_mark(function->closure);
+                gc_mark(function->receiver);
+                break;
+        }
+        case GC_INSTANCE: {
+                LoxInstance *instance = pointer;
+                gc_mark(instance->class);
+                for (size_t i = 0; i < instance->shape->num_fields; i++) {
+                        gc_mark(instance->fields[i]);
+                }
+                break;
+        }
+        case GC_OBJECT: {
+                Object *object = pointer;
+                if (object_is_lox_callable(object)) {
+                        gc_mark(object_as_lox_callable(object));
+                } else if (object_is_lox_instance(object)) {
+                        gc_mark(object_as_lox_instance(object));
+                }
+                break;
+        }
+        case GC_UPVALUE:
+                gc_mark(((Upvalue *)pointer)->closed);
+                break;
+        }
+}
+
+static void finalize(Header *header) {
+        void *pointer = header + 1;
+        switch (header->type) {
+        case GC_CLASS:
+                map_destruct(((LoxClass *)pointer)->methods);
+                gc.class_epoch++;
+                break;
+        case GC_ENVIRONMENT: {
+                Environment *environment = pointer;
+                if (environment->values != NULL) {
+                        map_destruct(environment->values);
+                }
+                break;
+        }
+        case GC_INSTANCE:
+                free(((LoxInstance *)pointer)->fields);
+                break;
+        default:
+                break;
+        }
+        free(header);
+}
+
+static void sweep(void) {
+        Header **link = &gc.objects;
+        while (*link != NULL) {
+                Header *header = *link;
+                if (header->is_marked) {
+                        header->is_marked = false;
+                        link = &header->next;
+                        continue;
+                }
+                *link = header->next;
+                gc.bytes_allocated -= header->size;
+                gc.total_reclaimed += header->size;
+                finalize(header);
+        }
+}
+
+static double now(void) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void collect(void) {
+        double start = now();
+
+        gc.mark_roots();
+        for (size_t i = 0; i < gc.num_roots; i++) {
+                gc_mark(gc.roots[i]);
+        }
+        while (gc.num_gray > 0) {
+                blacken(gc.gray[--gc.num_gray]);
+        }
+        sweep();
+
+        size_t next_collection = gc.bytes_allocated * gc.growth_factor;
+        gc.next_collection = next_collection < MIN_NEXT_COLLECTION ? MIN_NEXT_COLLECTION : next_collection;
+
+        double pause = now() - start;
+        gc.num_collections++;
+        gc.total_pause += pause;
+        if (pause > gc.max_pause) {
+                gc.max_pause = pause;
+        }
+}
+
+void gc_maybe_collect(void) {
+        if (gc.bytes_allocated > gc.next_collection) {
+                collect();
+        }
+}
+
+size_t gc_class_epoch(void) {
+        return gc.class_epoch;
+}
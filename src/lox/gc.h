@@ -0,0 +1,35 @@
+#ifndef CODECRAFTERS_INTERPRETER_LOX_GC_H
+#define CODECRAFTERS_INTERPRETER_LOX_GC_H
+
+#include <stddef.h>
+
+#include "util/map.h"
+
+typedef enum {
+        GC_BOUND_METHOD,
+        GC_CLASS,
+        GC_CLOSURE,
+        GC_ENVIRONMENT,
+        GC_FUNCTION,
+        GC_INSTANCE,
+        GC_OBJECT,
+        GC_UPVALUE,
+} GcType;
+
+typedef void (*RootMarker)(void);
+
+void *gc_allocate(GcType type, size_t size);
+void *gc_allocate_permanent(size_t size);
+
+void gc_enable(RootMarker mark_roots);
+void gc_enable_stats(void);
+void gc_set_growth_factor(double growth_factor);
+
+void gc_mark(const void *pointer);
+void gc_mark_values(const Map *map);
+void gc_push_root(const void *pointer);
+void gc_pop_roots(size_t num_roots);
+void gc_maybe_collect(void);
+size_t gc_class_epoch(void);
+
+#endif
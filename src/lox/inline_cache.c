@@ -0,0 +1,43 @@
+#include "lox/inline_cache.h"
+#include "lox/gc.h"
+#include "util/arena.h"
+
+InlineCache *inline_cache_construct(void) {
+        InlineCache *cache = arena_allocate(sizeof(InlineCache));
+        inline_cache_init(cache);
+        return cache;
+}
+
+void inline_cache_init(InlineCache *cache) {
+        cache->epoch = gc_class_epoch();
+        cache->size = 0;
+}
+
+const InlineCacheEntry *inline_cache_find(const InlineCache *cache, const void *key) {
+        for (size_t i = 0; i < cache->size; i++) {
+                if (cache->entries[i].key == key) {
+                        return &cache->entries[i];
+                }
+        }
+        return NULL;
+}
+
+const InlineCacheEntry *inline_cache_find_class(InlineCache *cache, const void *class) {
+        size_t epoch = gc_class_epoch();
+        if (cache->epoch != epoch) {
+                cache->epoch = epoch;
+                cache->size = 0;
+                return NULL;
+        }
+        return inline_cache_find(cache, class);
+}
+
+void inline_cache_put(InlineCache *cache, const void *key, void *value, size_t index) {
+        if (cache->size == INLINE_CACHE_CAPACITY) {
+                return;
+        }
+        InlineCacheEntry *entry = &cache->entries[cache->size++];
+        entry->key = key;
+        entry->value = value;
+        entry->index = index;
+}
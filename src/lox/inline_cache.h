@@ -0,0 +1,26 @@
+#ifndef CODECRAFTERS_INTERPRETER_LOX_INLINE_CACHE_H
+#define CODECRAFTERS_INTERPRETER_LOX_INLINE_CACHE_H
+
+#include <stddef.h>
+
+#define INLINE_CACHE_CAPACITY 4
+
+typedef struct {
+        const void *key;
+        void *value;
+        size_t index;
+} InlineCacheEntry;
+
+typedef struct {
+        size_t epoch;
+        size_t size;
+        InlineCacheEntry entries[INLINE_CACHE_CAPACITY];
+} InlineCache;
+
+InlineCache *inline_cache_construct(void);
+void inline_cache_init(InlineCache *cache);
+const InlineCacheEntry *inline_cache_find(const InlineCache *cache, const void *key);
+const InlineCacheEntry *inline_cache_find_class(InlineCache *cache, const void *class);
+void inline_cache_put(InlineCache *cache, const void *key, void *value, size_t index);
+
+#endif
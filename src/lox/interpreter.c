@@ -1,7 +1,9 @@
 #include "lox/interpreter.h"
+#include "lox/ast.h"
 #include "lox/environment.h"
 #include "lox/errors.h"
 #include "lox/expr.h"
+#include "lox/gc.h"
 #include "lox/lox_callable.h"
 #include "lox/lox_class.h"
 #include "lox/lox_function.h"
@@ -9,8 +11,8 @@
 #include "lox/object.h"
 #include "lox/stmt.h"
 #include "lox/token.h"
+#include "util/intern.h"
 #include "util/map.h"
-#include "util/vector.h"
 #include "util/xmalloc.h"
 
 #include <err.h>
@@ -21,88 +23,190 @@
 static struct {
         Environment *globals;
         Environment *environment;
-        Map *locals;
+        Object **arguments;
+        size_t num_arguments;
+        size_t arguments_capacity;
 } interpreter;
 
+static void mark_roots(void) {
+        gc_mark(interpreter.globals);
+        gc_mark(interpreter.environment);
+        for (size_t i = 0; i < interpreter.num_arguments; i++) {
+                gc_mark(interpreter.arguments[i]);
+        }
+}
+
 static void init(void) {
         static bool initialized = false;
         if (initialized) {
                 return;
         }
 
-        interpreter.globals = environment_construct(NULL);
+        gc_enable(mark_roots);
+        interpreter.globals = environment_construct(NULL, 0);
         LoxClock *lox_clock = lox_clock_construct();
-        environment_define(interpreter.globals, "clock", lox_callable_object_construct((LoxCallable *)lox_clock));
+        environment_define(interpreter.globals, intern_string("clock"), lox_callable_object_construct((LoxCallable *)lox_clock));
         interpreter.environment = interpreter.globals;
-        interpreter.locals = map_construct(ptr_compare);
+        interpreter.arguments_capacity = 256;
+        interpreter.arguments = xmalloc(sizeof(Object *) * interpreter.arguments_capacity);
+        interpreter.num_arguments = 0;
 
         initialized = true;
 }
 
-static const char *stringify(const Object *object) {
-        static char str[256];
-        snprintf(str, sizeof(str), "%s", object_to_string(object));
-
-        if (object_is_number(object)) {
-                size_t n = strlen(str);
-                char *p = str + n - 2;
-                if (n >= 2 && strcmp(p, ".0") == 0) {
-                        *p = '\0';
-                }
+static void push_argument(Object *argument) {
+        if (interpreter.num_arguments == interpreter.arguments_capacity) {
+                interpreter.arguments_capacity *= 2;
+                size_t size = sizeof(Object *) * interpreter.arguments_capacity;
+                interpreter.arguments = xrealloc(interpreter.arguments, size);
         }
-
-        return str;
+        interpreter.arguments[interpreter.num_arguments++] = argument;
 }
 
-static char *concat(const char *s1, const char *s2) {
-        size_t size = strlen(s1) + strlen(s2) + 1;
-        char *res = xmalloc(size);
-        snprintf(res, size, "%s%s", s1, s2);
-        return res;
-}
-
-static void check_number_operand(const Token *operator, const Object *operand) {
+static void check_number_operand(const Expr *expr, const Object *operand) {
         if (object_is_number(operand)) {
                 return;
         }
-        interpret_error(operator, "Operand must be a number.");
+        interpret_error(expr->line, "Operand must be a number.");
 }
 
-static void check_number_operands(const Token *operator, const Object *left, const Object *right) {
+static void check_number_operands(const Expr *expr, const Object *left, const Object *right) {
         if (object_is_number(left) && object_is_number(right)) {
                 return;
         }
-        interpret_error(operator, "Operands must be numbers.");
+        interpret_error(expr->line, "Operands must be numbers.");
+}
+
+static Object *lookup_local(const VariableLocation *location) {
+        return environment_get_at(interpreter.environment, location->depth, location->slot);
+}
+
+static Object *lookup_variable(const char *name, size_t line, const VariableLocation *location) {
+        if (location->is_local) {
+                return lookup_local(location);
+        }
+        return environment_get(interpreter.globals, name, line);
 }
 
-static Object *lookup_variable(const Token *name, const Expr *expr) {
-        if (map_contains(interpreter.locals, expr)) {
-                size_t depth = (size_t)map_get(interpreter.locals, expr);
-                return environment_get_at(interpreter.environment, name->lexeme, depth);
+static Object *lookup_keyword(const char *keyword, size_t line, const VariableLocation *location) {
+        if (location->is_local) {
+                return lookup_local(location);
         }
-        return environment_get(interpreter.globals, name);
+        return environment_get(interpreter.globals, intern_string(keyword), line);
 }
 
+static void define_variable(const char *name, size_t slot, Object *value) {
+        if (interpreter.environment == interpreter.globals) {
+                environment_define(interpreter.globals, name, value);
+        } else {
+                environment_define_at(interpreter.environment, slot, value);
+        }
+}
+
+typedef enum {
+        EXPR_HANDLER_NONE,
+        EXPR_HANDLER_ADD,
+        EXPR_HANDLER_ADD_NUMBER,
+        EXPR_HANDLER_ADD_NUMBERS,
+        EXPR_HANDLER_AND,
+        EXPR_HANDLER_ASSIGN_SLOT,
+        EXPR_HANDLER_CONCAT,
+        EXPR_HANDLER_DIVIDE,
+        EXPR_HANDLER_DIVIDE_NUMBER,
+        EXPR_HANDLER_ENCLOSING_SLOT,
+        EXPR_HANDLER_EQUAL,
+        EXPR_HANDLER_GREATER,
+        EXPR_HANDLER_GREATER_EQUAL,
+        EXPR_HANDLER_GREATER_EQUAL_NUMBER,
+        EXPR_HANDLER_GREATER_NUMBER,
+        EXPR_HANDLER_GROUPING,
+        EXPR_HANDLER_LESS,
+        EXPR_HANDLER_LESS_EQUAL,
+        EXPR_HANDLER_LESS_EQUAL_NUMBER,
+        EXPR_HANDLER_LESS_NUMBER,
+        EXPR_HANDLER_LITERAL,
+        EXPR_HANDLER_MULTIPLY,
+        EXPR_HANDLER_MULTIPLY_NUMBER,
+        EXPR_HANDLER_NEGATE,
+        EXPR_HANDLER_NOT,
+        EXPR_HANDLER_NOT_EQUAL,
+        EXPR_HANDLER_OR,
+        EXPR_HANDLER_SLOT,
+        EXPR_HANDLER_SUBTRACT,
+        EXPR_HANDLER_SUBTRACT_NUMBER,
+} ExprHandlerType;
+
+typedef struct {
+        Object *(*evaluate)(const Expr *expr);
+        bool (*test)(const Expr *expr);
+} ExprHandler;
+
 static Object *evaluate_expr(const Expr *expr);
 
+static bool is_number_literal(AstRef ref) {
+        const Expr *expr = ast_node(ref);
+        return expr->type == EXPR_LITERAL && object_is_number(((const LiteralExpr *)expr)->value);
+}
+
+static ExprHandlerType select_binary_handler(const BinaryExpr *binary_expr) {
+        bool has_number_operand = is_number_literal(binary_expr->right);
+        switch (binary_expr->base.operator) {
+        case TOKEN_BANG_EQUAL:
+                return EXPR_HANDLER_NOT_EQUAL;
+        case TOKEN_EQUAL_EQUAL:
+                return EXPR_HANDLER_EQUAL;
+        case TOKEN_GREATER:
+                return has_number_operand ? EXPR_HANDLER_GREATER_NUMBER : EXPR_HANDLER_GREATER;
+        case TOKEN_GREATER_EQUAL:
+                return has_number_operand ? EXPR_HANDLER_GREATER_EQUAL_NUMBER : EXPR_HANDLER_GREATER_EQUAL;
+        case TOKEN_LESS:
+                return has_number_operand ? EXPR_HANDLER_LESS_NUMBER : EXPR_HANDLER_LESS;
+        case TOKEN_LESS_EQUAL:
+                return has_number_operand ? EXPR_HANDLER_LESS_EQUAL_NUMBER : EXPR_HANDLER_LESS_EQUAL;
+        case TOKEN_MINUS:
+                return has_number_operand ? EXPR_HANDLER_SUBTRACT_NUMBER : EXPR_HANDLER_SUBTRACT;
+        case TOKEN_PLUS:
+                return has_number_operand ? EXPR_HANDLER_ADD_NUMBER : EXPR_HANDLER_NONE;
+        case TOKEN_SLASH:
+                return has_number_operand ? EXPR_HANDLER_DIVIDE_NUMBER : EXPR_HANDLER_DIVIDE;
+        case TOKEN_STAR:
+                return has_number_operand ? EXPR_HANDLER_MULTIPLY_NUMBER : EXPR_HANDLER_MULTIPLY;
+        default:
+                errx(EXIT_FAILURE, "unexpected operator");
+        }
+}
+
 static Object *evaluate_assign_expr(const AssignExpr *assign_expr) {
-        Object *value = evaluate_expr(assign_expr->value);
+        Object *value = evaluate_expr(ast_node(assign_expr->value));
 
-        if (map_contains(interpreter.locals, assign_expr)) {
-                size_t depth = (size_t)map_get(interpreter.locals, assign_expr);
-                environment_assign_at(interpreter.environment, assign_expr->name, value, depth);
+        const VariableLocation *location = &assign_expr->location;
+        if (location->is_local) {
+                environment_assign_at(interpreter.environment, location->depth, location->slot, value);
         } else {
-                environment_assign(interpreter.globals, assign_expr->name, value);
+                environment_assign(interpreter.globals, assign_expr->name, assign_expr->base.line, value);
         }
 
         return value;
 }
 
-static Object *evaluate_binary_expr(const BinaryExpr *binary_expr) {
-        Object *left = evaluate_expr(binary_expr->left);
-        Object *right = evaluate_expr(binary_expr->right);
-        Token *operator = binary_expr->operator;
-        switch (operator->type) {
+static void quicken(const Expr *expr, ExprHandlerType handler) {
+        ((Expr *)expr)->handler = handler;
+}
+
+static ExprHandlerType observe_binary_operands(const BinaryExpr *binary_expr, const Object *left, const Object *right) {
+        ExprHandlerType handler = select_binary_handler(binary_expr);
+        if (handler != EXPR_HANDLER_NONE) {
+                return handler;
+        } else if (object_is_number(left) && object_is_number(right)) {
+                return EXPR_HANDLER_ADD_NUMBERS;
+        } else if (object_is_string(left) && object_is_string(right)) {
+                return EXPR_HANDLER_CONCAT;
+        }
+        return EXPR_HANDLER_ADD;
+}
+
+static Object *apply_binary_operator(const Expr *operator, Object *left, Object *right) {
+        switch (operator->operator) {
         case TOKEN_BANG_EQUAL:
                 return boolean_object_construct(!object_equals(left, right));
         case TOKEN_EQUAL_EQUAL:
@@ -124,12 +228,11 @@ static Object *evaluate_binary_expr(const BinaryExpr *binary_expr) {
                 return number_object_construct(object_as_number(left) - object_as_number(right));
         case TOKEN_PLUS:
                 if (object_is_string(left) && object_is_string(right)) {
-                        char *s = concat(object_as_string(left), object_as_string(right));
-                        return string_object_construct(s);
+                        return string_object_concat(left, right);
                 } else if (object_is_number(left) && object_is_number(right)) {
                         return number_object_construct(object_as_number(left) + object_as_number(right));
                 } else {
-                        interpret_error(operator, "Operands must be two numbers or two strings.");
+                        interpret_error(operator->line, "Operands must be two numbers or two strings.");
                 }
         case TOKEN_SLASH:
                 check_number_operands(operator, left, right);
@@ -142,40 +245,97 @@ static Object *evaluate_binary_expr(const BinaryExpr *binary_expr) {
         }
 }
 
-static Object *evaluate_call_expr(const CallExpr *call_expr) {
-        Object *callee = evaluate_expr(call_expr->callee);
+static Object *evaluate_binary_expr(const BinaryExpr *binary_expr) {
+        Object *left = evaluate_expr(ast_node(binary_expr->left));
+        gc_push_root(left);
+        Object *right = evaluate_expr(ast_node(binary_expr->right));
+        gc_pop_roots(1);
+        quicken(&binary_expr->base, observe_binary_operands(binary_expr, left, right));
+        return apply_binary_operator(&binary_expr->base, left, right);
+}
+
+static LoxInstance *evaluate_instance(const GetExpr *get_expr, Object **object) {
+        *object = evaluate_expr(ast_node(get_expr->object));
+        if (!object_is_lox_instance(*object)) {
+                interpret_error(get_expr->base.line, "Only instances have properties.");
+        }
+        return object_as_lox_instance(*object);
+}
 
-        Vector *arguments = vector_construct();
-        size_t num_arguments = vector_size(call_expr->arguments);
+static size_t push_arguments(const CallExpr *call_expr) {
+        const AstRef *arguments = ast_refs(call_expr->arguments);
+        size_t num_arguments = call_expr->arguments.size;
         for (size_t i = 0; i < num_arguments; i++) {
-                Expr *argument = vector_at(call_expr->arguments, i);
-                vector_push_back(arguments, evaluate_expr(argument));
+                push_argument(evaluate_expr(ast_node(arguments[i])));
+        }
+        return num_arguments;
+}
+
+static Object *evaluate_invoke_expr(const CallExpr *call_expr, const GetExpr *get_expr, Object **callee) {
+        Object *receiver;
+        LoxInstance *instance = evaluate_instance(get_expr, &receiver);
+        if (lox_instance_get_field(instance, get_expr->name, get_expr->field_cache, callee)) {
+                return NULL;
+        }
+        LoxFunction *method = lox_instance_get_method(instance, get_expr->name, get_expr->base.line, get_expr->method_cache);
+
+        size_t base = interpreter.num_arguments;
+        push_argument(receiver);
+        size_t num_arguments = push_arguments(call_expr);
+
+        size_t arity = lox_function_arity(method);
+        if (num_arguments != arity) {
+                interpret_error(call_expr->base.line, "Expected %zu arguments but got %zu.", arity, num_arguments);
         }
 
+        Object *result = lox_function_invoke(method, receiver, interpreter.arguments + base + 1);
+        interpreter.num_arguments = base;
+        return result;
+}
+
+static Object *evaluate_call_expr(const CallExpr *call_expr) {
+        Object *callee;
+        const Expr *callee_expr = ast_node(call_expr->callee);
+        if (callee_expr->type == EXPR_GET) {
+                Object *result = evaluate_invoke_expr(call_expr, (const GetExpr *)callee_expr, &callee);
+                if (result != NULL) {
+                        return result;
+                }
+        } else {
+                callee = evaluate_expr(callee_expr);
+        }
+        size_t base = interpreter.num_arguments;
+        push_argument(callee);
+        size_t num_arguments = push_arguments(call_expr);
+
         if (!object_is_lox_callable(callee)) {
-                interpret_error(call_expr->paren, "Can only call functions and classes.");
+                interpret_error(call_expr->base.line, "Can only call functions and classes.");
         }
         LoxCallable *function = object_as_lox_callable(callee);
 
         size_t arity = lox_callable_arity(function);
         if (num_arguments != arity) {
-                interpret_error(call_expr->paren, "Expected %zu arguments but got %zu.", arity, num_arguments);
+                interpret_error(call_expr->base.line, "Expected %zu arguments but got %zu.", arity, num_arguments);
         }
 
-        return lox_callable_call(function, arguments);
+        Object *result = lox_callable_call(function, interpreter.arguments + base + 1);
+        interpreter.num_arguments = base;
+        return result;
 }
 
 static Object *evaluate_get_expr(const GetExpr *get_expr) {
-        Object *object = evaluate_expr(get_expr->object);
-        if (!object_is_lox_instance(object)) {
-                interpret_error(get_expr->name, "Only instances have properties.");
+        Object *object;
+        LoxInstance *instance = evaluate_instance(get_expr, &object);
+        Object *value;
+        if (lox_instance_get_field(instance, get_expr->name, get_expr->field_cache, &value)) {
+                return value;
         }
-        LoxInstance *instance = object_as_lox_instance(object);
-        return lox_instance_get(instance, get_expr->name);
+        LoxFunction *method = lox_instance_get_method(instance, get_expr->name, get_expr->base.line, get_expr->method_cache);
+        return lox_callable_object_construct((LoxCallable *)lox_function_bind(method, object));
 }
 
 static Object *evaluate_grouping_expr(const GroupingExpr *grouping_expr) {
-        return evaluate_expr(grouping_expr->expression);
+        return evaluate_expr(ast_node(grouping_expr->expression));
 }
 
 static Object *evaluate_literal_expr(const LiteralExpr *literal_expr) {
@@ -183,9 +343,8 @@ static Object *evaluate_literal_expr(const LiteralExpr *literal_expr) {
 }
 
 static Object *evaluate_logical_expr(const LogicalExpr *logical_expr) {
-        Object *left = evaluate_expr(logical_expr->left);
-        Token *operator = logical_expr->operator;
-        switch (operator->type) {
+        Object *left = evaluate_expr(ast_node(logical_expr->left));
+        switch (logical_expr->base.operator) {
         case TOKEN_AND:
                 if (!object_is_truthy(left)) {
                         return left;
@@ -199,44 +358,42 @@ static Object *evaluate_logical_expr(const LogicalExpr *logical_expr) {
         default:
                 errx(EXIT_FAILURE, "unexpected operator");
         }
-        return evaluate_expr(logical_expr->right);
+        return evaluate_expr(ast_node(logical_expr->right));
 }
 
 static Object *evaluate_set_expr(const SetExpr *set_expr) {
-        Object *object = evaluate_expr(set_expr->object);
+        Object *object = evaluate_expr(ast_node(set_expr->object));
         if (!object_is_lox_instance(object)) {
-                interpret_error(set_expr->name, "Only instances have fields.");
+                interpret_error(set_expr->base.line, "Only instances have fields.");
         }
-        Object *value = evaluate_expr(set_expr->value);
+        gc_push_root(object);
+        Object *value = evaluate_expr(ast_node(set_expr->value));
+        gc_pop_roots(1);
         LoxInstance *instance = object_as_lox_instance(object);
-        lox_instance_set(instance, set_expr->name, value);
+        lox_instance_set(instance, set_expr->name, value, set_expr->cache);
         return value;
 }
 
 static Object *evaluate_super_expr(const SuperExpr *super_expr) {
-        size_t depth = (size_t)map_get(interpreter.locals, super_expr);
-
-        Object *superclass_object = environment_get_at(interpreter.environment, "super", depth);
+        Object *superclass_object = lookup_keyword("super", super_expr->base.line, &super_expr->location);
         LoxClass *superclass = (LoxClass *)object_as_lox_callable(superclass_object);
+        Object *receiver = lookup_keyword("this", super_expr->base.line, &super_expr->this_location);
 
-        Object *instance_object = environment_get_at(interpreter.environment, "this", depth - 1);
-        LoxInstance *instance = object_as_lox_instance(instance_object);
-
-        LoxFunction *method = lox_class_find_method(superclass, super_expr->method->lexeme);
+        LoxFunction *method = lox_class_find_method(superclass, super_expr->method);
         if (method == NULL) {
-                interpret_error(super_expr->method, "Undefined property '%s'.", super_expr->method->lexeme);
+                interpret_error(super_expr->method_line, "Undefined property '%s'.", super_expr->method);
         }
-        return lox_callable_object_construct((LoxCallable *)lox_function_bind(method, instance));
+        return lox_callable_object_construct((LoxCallable *)lox_function_bind(method, receiver));
 }
 
 static Object *evaluate_this_expr(const ThisExpr *this_expr) {
-        return lookup_variable(this_expr->keyword, (const Expr *)this_expr);
+        return lookup_keyword("this", this_expr->base.line, &this_expr->location);
 }
 
 static Object *evaluate_unary_expr(const UnaryExpr *unary_expr) {
-        Object *right = evaluate_expr(unary_expr->right);
-        Token *operator = unary_expr->operator;
-        switch (operator->type) {
+        Object *right = evaluate_expr(ast_node(unary_expr->right));
+        const Expr *operator = &unary_expr->base;
+        switch (operator->operator) {
         case TOKEN_BANG:
                 return boolean_object_construct(!object_is_truthy(right));
         case TOKEN_MINUS:
@@ -248,10 +405,226 @@ static Object *evaluate_unary_expr(const UnaryExpr *unary_expr) {
 }
 
 static Object *evaluate_variable_expr(const VariableExpr *variable_expr) {
-        return lookup_variable(variable_expr->name, (const Expr *)variable_expr);
+        return lookup_variable(variable_expr->name, variable_expr->base.line, &variable_expr->location);
+}
+
+static Object *number_operand(AstRef ref) {
+        return ((const LiteralExpr *)ast_node(ref))->value;
+}
+
+static void check_number_left_operand(const Expr *expr, const Object *left) {
+        if (object_is_number(left)) {
+                return;
+        }
+        interpret_error(expr->line, "Operands must be numbers.");
+}
+
+#define ARITHMETIC_HANDLERS(name, op) \
+        static Object *evaluate_##name##_expr(const Expr *expr) { \
+                const BinaryExpr *binary_expr = (const BinaryExpr *)expr; \
+                Object *left = evaluate_expr(ast_node(binary_expr->left)); \
+                gc_push_root(left); \
+                Object *right = evaluate_expr(ast_node(binary_expr->right)); \
+                gc_pop_roots(1); \
+                check_number_operands(expr, left, right); \
+                return number_object_construct(object_as_number(left) op object_as_number(right)); \
+        } \
+        static Object *evaluate_##name##_number_expr(const Expr *expr) { \
+                const BinaryExpr *binary_expr = (const BinaryExpr *)expr; \
+                Object *left = evaluate_expr(ast_node(binary_expr->left)); \
+                check_number_left_operand(expr, left); \
+                return number_object_construct(object_as_number(left) op object_as_number(number_operand(binary_expr->right))); \
+        }
+
+#define COMPARISON_HANDLERS(name, op) \
+        static bool test_##name(const Expr *expr) { \
+                const BinaryExpr *binary_expr = (const BinaryExpr *)expr; \
+                Object *left = evaluate_expr(ast_node(binary_expr->left)); \
+                gc_push_root(left); \
+                Object *right = evaluate_expr(ast_node(binary_expr->right)); \
+                gc_pop_roots(1); \
+                check_number_operands(expr, left, right); \
+                return object_as_number(left) op object_as_number(right); \
+        } \
+        static bool test_##name##_number(const Expr *expr) { \
+                const BinaryExpr *binary_expr = (const BinaryExpr *)expr; \
+                Object *left = evaluate_expr(ast_node(binary_expr->left)); \
+                check_number_left_operand(expr, left); \
+                return object_as_number(left) op object_as_number(number_operand(binary_expr->right)); \
+        } \
+        static Object *evaluate_##name##_expr(const Expr *expr) { \
+                return boolean_object_construct(test_##name(expr)); \
+        } \
+        static Object *evaluate_##name##_number_expr(const Expr *expr) { \
+                return boolean_object_construct(test_##name##_number(expr)); \
+        }
+
+ARITHMETIC_HANDLERS(divide, /)
+ARITHMETIC_HANDLERS(multiply, *)
+ARITHMETIC_HANDLERS(subtract, -)
+COMPARISON_HANDLERS(greater, >)
+COMPARISON_HANDLERS(greater_equal, >=)
+COMPARISON_HANDLERS(less, <)
+COMPARISON_HANDLERS(less_equal, <=)
+
+#undef ARITHMETIC_HANDLERS
+#undef COMPARISON_HANDLERS
+
+static Object *evaluate_add_expr(const Expr *expr) {
+        const BinaryExpr *binary_expr = (const BinaryExpr *)expr;
+        Object *left = evaluate_expr(ast_node(binary_expr->left));
+        gc_push_root(left);
+        Object *right = evaluate_expr(ast_node(binary_expr->right));
+        gc_pop_roots(1);
+        if (object_is_number(left) && object_is_number(right)) {
+                return number_object_construct(object_as_number(left) + object_as_number(right));
+        } else if (object_is_string(left) && object_is_string(right)) {
+                return string_object_concat(left, right);
+        }
+        interpret_error(expr->line, "Operands must be two numbers or two strings.");
+}
+
+static Object *evaluate_add_number_expr(const Expr *expr) {
+        const BinaryExpr *binary_expr = (const BinaryExpr *)expr;
+        Object *left = evaluate_expr(ast_node(binary_expr->left));
+        if (!object_is_number(left)) {
+                interpret_error(expr->line, "Operands must be two numbers or two strings.");
+        }
+        return number_object_construct(object_as_number(left) + object_as_number(number_operand(binary_expr->right)));
+}
+
+static Object *evaluate_add_numbers_expr(const Expr *expr) {
+        const BinaryExpr *binary_expr = (const BinaryExpr *)expr;
+        Object *left = evaluate_expr(ast_node(binary_expr->left));
+        gc_push_root(left);
+        Object *right = evaluate_expr(ast_node(binary_expr->right));
+        gc_pop_roots(1);
+        if (object_is_number(left) && object_is_number(right)) {
+                return number_object_construct(object_as_number(left) + object_as_number(right));
+        }
+        quicken(expr, EXPR_HANDLER_ADD);
+        return apply_binary_operator(expr, left, right);
+}
+
+static Object *evaluate_and_expr(const Expr *expr) {
+        const LogicalExpr *logical_expr = (const LogicalExpr *)expr;
+        Object *left = evaluate_expr(ast_node(logical_expr->left));
+        if (!object_is_truthy(left)) {
+                return left;
+        }
+        return evaluate_expr(ast_node(logical_expr->right));
+}
+
+static Object *evaluate_assign_slot_expr(const Expr *expr) {
+        const AssignExpr *assign_expr = (const AssignExpr *)expr;
+        Object *value = evaluate_expr(ast_node(assign_expr->value));
+        interpreter.environment->slots[assign_expr->location.slot] = value;
+        return value;
+}
+
+static Object *evaluate_concat_expr(const Expr *expr) {
+        const BinaryExpr *binary_expr = (const BinaryExpr *)expr;
+        Object *left = evaluate_expr(ast_node(binary_expr->left));
+        gc_push_root(left);
+        Object *right = evaluate_expr(ast_node(binary_expr->right));
+        gc_pop_roots(1);
+        if (object_is_string(left) && object_is_string(right)) {
+                return string_object_concat(left, right);
+        }
+        quicken(expr, EXPR_HANDLER_ADD);
+        return apply_binary_operator(expr, left, right);
+}
+
+static Object *evaluate_enclosing_slot_expr(const Expr *expr) {
+        return interpreter.environment->enclosing->slots[((const VariableExpr *)expr)->location.slot];
+}
+
+static Object *evaluate_equal_expr(const Expr *expr) {
+        const BinaryExpr *binary_expr = (const BinaryExpr *)expr;
+        Object *left = evaluate_expr(ast_node(binary_expr->left));
+        gc_push_root(left);
+        Object *right = evaluate_expr(ast_node(binary_expr->right));
+        gc_pop_roots(1);
+        return boolean_object_construct(object_equals(left, right));
+}
+
+static Object *evaluate_grouped_expr(const Expr *expr) {
+        return evaluate_expr(ast_node(((const GroupingExpr *)expr)->expression));
+}
+
+static Object *evaluate_constant_expr(const Expr *expr) {
+        return ((const LiteralExpr *)expr)->value;
+}
+
+static Object *evaluate_negate_expr(const Expr *expr) {
+        Object *right = evaluate_expr(ast_node(((const UnaryExpr *)expr)->right));
+        check_number_operand(expr, right);
+        return number_object_construct(-object_as_number(right));
+}
+
+static Object *evaluate_not_expr(const Expr *expr) {
+        return boolean_object_construct(!object_is_truthy(evaluate_expr(ast_node(((const UnaryExpr *)expr)->right))));
 }
 
+static Object *evaluate_not_equal_expr(const Expr *expr) {
+        const BinaryExpr *binary_expr = (const BinaryExpr *)expr;
+        Object *left = evaluate_expr(ast_node(binary_expr->left));
+        gc_push_root(left);
+        Object *right = evaluate_expr(ast_node(binary_expr->right));
+        gc_pop_roots(1);
+        return boolean_object_construct(!object_equals(left, right));
+}
+
+static Object *evaluate_or_expr(const Expr *expr) {
+        const LogicalExpr *logical_expr = (const LogicalExpr *)expr;
+        Object *left = evaluate_expr(ast_node(logical_expr->left));
+        if (object_is_truthy(left)) {
+                return left;
+        }
+        return evaluate_expr(ast_node(logical_expr->right));
+}
+
+static Object *evaluate_slot_expr(const Expr *expr) {
+        return interpreter.environment->slots[((const VariableExpr *)expr)->location.slot];
+}
+
+static const ExprHandler expr_handlers[] = {
+        [EXPR_HANDLER_NONE] = {NULL, NULL},
+        [EXPR_HANDLER_ADD] = {evaluate_add_expr, NULL},
+        [EXPR_HANDLER_ADD_NUMBER] = {evaluate_add_number_expr, NULL},
+        [EXPR_HANDLER_ADD_NUMBERS] = {evaluate_add_numbers_expr, NULL},
+        [EXPR_HANDLER_AND] = {evaluate_and_expr, NULL},
+        [EXPR_HANDLER_ASSIGN_SLOT] = {evaluate_assign_slot_expr, NULL},
+        [EXPR_HANDLER_CONCAT] = {evaluate_concat_expr, NULL},
+        [EXPR_HANDLER_DIVIDE] = {evaluate_divide_expr, NULL},
+        [EXPR_HANDLER_DIVIDE_NUMBER] = {evaluate_divide_number_expr, NULL},
+        [EXPR_HANDLER_ENCLOSING_SLOT] = {evaluate_enclosing_slot_expr, NULL},
+        [EXPR_HANDLER_EQUAL] = {evaluate_equal_expr, NULL},
+        [EXPR_HANDLER_GREATER] = {evaluate_greater_expr, test_greater},
+        [EXPR_HANDLER_GREATER_EQUAL] = {evaluate_greater_equal_expr, test_greater_equal},
+        [EXPR_HANDLER_GREATER_EQUAL_NUMBER] = {evaluate_greater_equal_number_expr, test_greater_equal_number},
+        [EXPR_HANDLER_GREATER_NUMBER] = {evaluate_greater_number_expr, test_greater_number},
+        [EXPR_HANDLER_GROUPING] = {evaluate_grouped_expr, NULL},
+        [EXPR_HANDLER_LESS] = {evaluate_less_expr, test_less},
+        [EXPR_HANDLER_LESS_EQUAL] = {evaluate_less_equal_expr, test_less_equal},
+        [EXPR_HANDLER_LESS_EQUAL_NUMBER] = {evaluate_less_equal_number_expr, test_less_equal_number},
+        [EXPR_HANDLER_LESS_NUMBER] = {evaluate_less_number_expr, test_less_number},
+        [EXPR_HANDLER_LITERAL] = {evaluate_constant_expr, NULL},
+        [EXPR_HANDLER_MULTIPLY] = {evaluate_multiply_expr, NULL},
+        [EXPR_HANDLER_MULTIPLY_NUMBER] = {evaluate_multiply_number_expr, NULL},
+        [EXPR_HANDLER_NEGATE] = {evaluate_negate_expr, NULL},
+        [EXPR_HANDLER_NOT] = {evaluate_not_expr, NULL},
+        [EXPR_HANDLER_NOT_EQUAL] = {evaluate_not_equal_expr, NULL},
+        [EXPR_HANDLER_OR] = {evaluate_or_expr, NULL},
+        [EXPR_HANDLER_SLOT] = {evaluate_slot_expr, NULL},
+        [EXPR_HANDLER_SUBTRACT] = {evaluate_subtract_expr, NULL},
+        [EXPR_HANDLER_SUBTRACT_NUMBER] = {evaluate_subtract_number_expr, NULL},
+};
+
 static Object *evaluate_expr(const Expr *expr) {
+        if (expr->handler != EXPR_HANDLER_NONE) {
+                return expr_handlers[expr->handler].evaluate(expr);
+        }
         switch (expr->type) {
         case EXPR_ASSIGN:
                 return evaluate_assign_expr((const AssignExpr *)expr);
@@ -283,88 +656,126 @@ static Object *evaluate_expr(const Expr *expr) {
 static Object *execute_stmt(const Stmt *stmt);
 
 static Object *execute_block_stmt(const BlockStmt *block_stmt) {
-        return execute_block(block_stmt->statements, environment_construct(interpreter.environment));
+        Environment *environment = environment_construct(interpreter.environment, block_stmt->num_slots);
+        return execute_block(block_stmt->statements, environment);
 }
 
 static Object *execute_class_stmt(const ClassStmt *class_stmt) {
         Object *superclass_object = NULL;
-        if (class_stmt->superclass != NULL) {
-                superclass_object = evaluate_variable_expr(class_stmt->superclass);
+        if (class_stmt->superclass != AST_NULL) {
+                const VariableExpr *superclass_expr = ast_node(class_stmt->superclass);
+                superclass_object = evaluate_variable_expr(superclass_expr);
                 if (!object_is_lox_callable(superclass_object) || object_as_lox_callable(superclass_object)->type != LOX_CALLABLE_CLASS) {
-                        interpret_error(class_stmt->superclass->name, "Superclass must be a class.");
+                        interpret_error(superclass_expr->base.line, "Superclass must be a class.");
                 }
         }
 
-        environment_define(interpreter.environment, class_stmt->name->lexeme, NULL);
+        define_variable(class_stmt->name, class_stmt->slot, NULL);
 
-        if (class_stmt->superclass != NULL) {
-                interpreter.environment = environment_construct(interpreter.environment);
-                environment_define(interpreter.environment, "super", superclass_object);
+        if (superclass_object != NULL) {
+                interpreter.environment = environment_construct(interpreter.environment, 1);
+                environment_define_at(interpreter.environment, 0, superclass_object);
         }
 
-        Map *methods = map_construct(str_compare);
-        size_t num_methods = vector_size(class_stmt->methods);
-        for (size_t i = 0; i < num_methods; i++) {
-                FunctionStmt *method = vector_at(class_stmt->methods, i);
-                bool is_initializer = strcmp(method->name->lexeme, "init") == 0;
+        LoxClass *superclass = superclass_object == NULL ? NULL : (LoxClass *)object_as_lox_callable(superclass_object);
+        Map *methods = map_construct(ptr_hash, ptr_compare);
+        if (superclass != NULL) {
+                map_put_all(methods, superclass->methods);
+        }
+        const AstRef *method_refs = ast_refs(class_stmt->methods);
+        for (size_t i = 0; i < class_stmt->methods.size; i++) {
+                const FunctionStmt *method = ast_node(method_refs[i]);
+                bool is_initializer = strcmp(method->name, "init") == 0;
                 LoxFunction *function = lox_function_construct(method, interpreter.environment, is_initializer);
-                map_put(methods, method->name->lexeme, function);
+                map_put(methods, method->name, function);
         }
 
-        LoxClass *superclass = superclass_object == NULL ? NULL : (LoxClass *)object_as_lox_callable(superclass_object);
-        LoxClass *class = lox_class_construct(class_stmt->name->lexeme, superclass, methods);
+        LoxClass *class = lox_class_construct(class_stmt->name, superclass, methods);
 
         if (superclass != NULL) {
                 interpreter.environment = interpreter.environment->enclosing;
         }
 
-        environment_assign(interpreter.environment, class_stmt->name, lox_callable_object_construct((LoxCallable *)class));
+        define_variable(class_stmt->name, class_stmt->slot, lox_callable_object_construct((LoxCallable *)class));
 
         return NULL;
 }
 
 static Object *execute_expression_stmt(const ExpressionStmt *expression_stmt) {
-        evaluate_expr(expression_stmt->expression);
+        evaluate_expr(ast_node(expression_stmt->expression));
         return NULL;
 }
 
 static Object *execute_function_stmt(const FunctionStmt *function_stmt) {
         LoxFunction *function = lox_function_construct(function_stmt, interpreter.environment, false);
         Object *object = lox_callable_object_construct((LoxCallable *)function);
-        environment_define(interpreter.environment, function_stmt->name->lexeme, object);
+        define_variable(function_stmt->name, function_stmt->slot, object);
         return NULL;
 }
 
 static Object *execute_if_stmt(const IfStmt *if_stmt) {
-        if (object_is_truthy(evaluate_expr(if_stmt->condition))) {
-                return execute_stmt(if_stmt->then_branch);
-        } else if (if_stmt->else_branch != NULL) {
-                return execute_stmt(if_stmt->else_branch);
+        if (object_is_truthy(evaluate_expr(ast_node(if_stmt->condition)))) {
+                return execute_stmt(ast_node(if_stmt->then_branch));
+        } else if (if_stmt->else_branch != AST_NULL) {
+                return execute_stmt(ast_node(if_stmt->else_branch));
         }
         return NULL;
 }
 
 static Object *execute_print_stmt(const PrintStmt *print_stmt) {
-        printf("%s\n", stringify(evaluate_expr(print_stmt->expression)));
+        printf("%s\n", object_stringify(evaluate_expr(ast_node(print_stmt->expression))));
         return NULL;
 }
 
 static Object *execute_return_stmt(const ReturnStmt *return_stmt) {
-        if (return_stmt->value == NULL) {
+        if (return_stmt->value == AST_NULL) {
                 return nil_object_construct();
         }
-        return evaluate_expr(return_stmt->value);
+        return evaluate_expr(ast_node(return_stmt->value));
 }
 
 static Object *execute_var_stmt(const VarStmt *var_stmt) {
-        Object *value = var_stmt->initializer == NULL ? nil_object_construct() : evaluate_expr(var_stmt->initializer);
-        environment_define(interpreter.environment, var_stmt->name->lexeme, value);
+        Object *value = var_stmt->initializer == AST_NULL ? nil_object_construct() : evaluate_expr(ast_node(var_stmt->initializer));
+        define_variable(var_stmt->name, var_stmt->slot, value);
         return NULL;
 }
 
 static Object *execute_while_stmt(const WhileStmt *while_stmt) {
-        while (object_is_truthy(evaluate_expr(while_stmt->condition))) {
-                Object *result = execute_stmt(while_stmt->body);
+        const Expr *condition = ast_node(while_stmt->condition);
+        const Stmt *body = ast_node(while_stmt->body);
+        while (object_is_truthy(evaluate_expr(condition))) {
+                Object *result = execute_stmt(body);
+                if (result != NULL) {
+                        return result;
+                }
+        }
+        return NULL;
+}
+
+typedef enum {
+        STMT_HANDLER_NONE,
+        STMT_HANDLER_IF_TEST,
+        STMT_HANDLER_WHILE_TEST,
+} StmtHandlerType;
+
+static Object *execute_if_test_stmt(const Stmt *stmt) {
+        const IfStmt *if_stmt = (const IfStmt *)stmt;
+        const Expr *condition = ast_node(if_stmt->condition);
+        if (expr_handlers[condition->handler].test(condition)) {
+                return execute_stmt(ast_node(if_stmt->then_branch));
+        } else if (if_stmt->else_branch != AST_NULL) {
+                return execute_stmt(ast_node(if_stmt->else_branch));
+        }
+        return NULL;
+}
+
+static Object *execute_while_test_stmt(const Stmt *stmt) {
+        const WhileStmt *while_stmt = (const WhileStmt *)stmt;
+        const Expr *condition = ast_node(while_stmt->condition);
+        bool (*test)(const Expr *expr) = expr_handlers[condition->handler].test;
+        const Stmt *body = ast_node(while_stmt->body);
+        while (test(condition)) {
+                Object *result = execute_stmt(body);
                 if (result != NULL) {
                         return result;
                 }
@@ -372,7 +783,17 @@ static Object *execute_while_stmt(const WhileStmt *while_stmt) {
         return NULL;
 }
 
+static Object *(*const stmt_handlers[])(const Stmt *stmt) = {
+        [STMT_HANDLER_NONE] = NULL,
+        [STMT_HANDLER_IF_TEST] = execute_if_test_stmt,
+        [STMT_HANDLER_WHILE_TEST] = execute_while_test_stmt,
+};
+
 static Object *execute_stmt(const Stmt *stmt) {
+        gc_maybe_collect();
+        if (stmt->handler != STMT_HANDLER_NONE) {
+                return stmt_handlers[stmt->handler](stmt);
+        }
         switch (stmt->type) {
         case STMT_BLOCK:
                 return execute_block_stmt((const BlockStmt *)stmt);
@@ -395,16 +816,158 @@ static Object *execute_stmt(const Stmt *stmt) {
         }
 }
 
+static ExprHandlerType select_variable_handler(const VariableLocation *location) {
+        if (!location->is_local || location->depth > 1) {
+                return EXPR_HANDLER_NONE;
+        }
+        return location->depth == 0 ? EXPR_HANDLER_SLOT : EXPR_HANDLER_ENCLOSING_SLOT;
+}
+
+static void specialize_expr(Expr *expr) {
+        switch (expr->type) {
+        case EXPR_ASSIGN: {
+                AssignExpr *assign_expr = (AssignExpr *)expr;
+                specialize_expr(ast_node(assign_expr->value));
+                if (assign_expr->location.is_local && assign_expr->location.depth == 0) {
+                        expr->handler = EXPR_HANDLER_ASSIGN_SLOT;
+                }
+                break;
+        }
+        case EXPR_BINARY: {
+                BinaryExpr *binary_expr = (BinaryExpr *)expr;
+                specialize_expr(ast_node(binary_expr->left));
+                specialize_expr(ast_node(binary_expr->right));
+                expr->handler = select_binary_handler(binary_expr);
+                break;
+        }
+        case EXPR_CALL: {
+                CallExpr *call_expr = (CallExpr *)expr;
+                specialize_expr(ast_node(call_expr->callee));
+                const AstRef *arguments = ast_refs(call_expr->arguments);
+                for (size_t i = 0; i < call_expr->arguments.size; i++) {
+                        specialize_expr(ast_node(arguments[i]));
+                }
+                break;
+        }
+        case EXPR_GET:
+                specialize_expr(ast_node(((GetExpr *)expr)->object));
+                break;
+        case EXPR_GROUPING:
+                specialize_expr(ast_node(((GroupingExpr *)expr)->expression));
+                expr->handler = EXPR_HANDLER_GROUPING;
+                break;
+        case EXPR_LITERAL:
+                expr->handler = EXPR_HANDLER_LITERAL;
+                break;
+        case EXPR_LOGICAL: {
+                LogicalExpr *logical_expr = (LogicalExpr *)expr;
+                specialize_expr(ast_node(logical_expr->left));
+                specialize_expr(ast_node(logical_expr->right));
+                expr->handler = expr->operator == TOKEN_AND ? EXPR_HANDLER_AND : EXPR_HANDLER_OR;
+                break;
+        }
+        case EXPR_SET: {
+                SetExpr *set_expr = (SetExpr *)expr;
+                specialize_expr(ast_node(set_expr->object));
+                specialize_expr(ast_node(set_expr->value));
+                break;
+        }
+        case EXPR_SUPER:
+        case EXPR_THIS:
+                break;
+        case EXPR_UNARY:
+                specialize_expr(ast_node(((UnaryExpr *)expr)->right));
+                expr->handler = expr->operator == TOKEN_BANG ? EXPR_HANDLER_NOT : EXPR_HANDLER_NEGATE;
+                break;
+        case EXPR_VARIABLE:
+                expr->handler = select_variable_handler(&((VariableExpr *)expr)->location);
+                break;
+        }
+}
+
+static bool has_test(AstRef condition) {
+        const Expr *expr = ast_node(condition);
+        return expr_handlers[expr->handler].test != NULL;
+}
+
+static void specialize_stmt(Stmt *stmt);
+
+static void specialize_stmt_list(AstList statements) {
+        const AstRef *refs = ast_refs(statements);
+        for (size_t i = 0; i < statements.size; i++) {
+                specialize_stmt(ast_node(refs[i]));
+        }
+}
+
+static void specialize_stmt(Stmt *stmt) {
+        switch (stmt->type) {
+        case STMT_BLOCK:
+                specialize_stmt_list(((BlockStmt *)stmt)->statements);
+                break;
+        case STMT_CLASS:
+                specialize_stmt_list(((ClassStmt *)stmt)->methods);
+                break;
+        case STMT_EXPRESSION:
+                specialize_expr(ast_node(((ExpressionStmt *)stmt)->expression));
+                break;
+        case STMT_FUNCTION:
+                specialize_stmt_list(((FunctionStmt *)stmt)->body);
+                break;
+        case STMT_IF: {
+                IfStmt *if_stmt = (IfStmt *)stmt;
+                specialize_expr(ast_node(if_stmt->condition));
+                specialize_stmt(ast_node(if_stmt->then_branch));
+                if (if_stmt->else_branch != AST_NULL) {
+                        specialize_stmt(ast_node(if_stmt->else_branch));
+                }
+                if (has_test(if_stmt->condition)) {
+                        stmt->handler = STMT_HANDLER_IF_TEST;
+                }
+                break;
+        }
+        case STMT_PRINT:
+                specialize_expr(ast_node(((PrintStmt *)stmt)->expression));
+                break;
+        case STMT_RETURN: {
+                ReturnStmt *return_stmt = (ReturnStmt *)stmt;
+                if (return_stmt->value != AST_NULL) {
+                        specialize_expr(ast_node(return_stmt->value));
+                }
+                break;
+        }
+        case STMT_VAR: {
+                VarStmt *var_stmt = (VarStmt *)stmt;
+                if (var_stmt->initializer != AST_NULL) {
+                        specialize_expr(ast_node(var_stmt->initializer));
+                }
+                break;
+        }
+        case STMT_WHILE: {
+                WhileStmt *while_stmt = (WhileStmt *)stmt;
+                specialize_expr(ast_node(while_stmt->condition));
+                specialize_stmt(ast_node(while_stmt->body));
+                if (has_test(while_stmt->condition)) {
+                        stmt->handler = STMT_HANDLER_WHILE_TEST;
+                }
+                break;
+        }
+        }
+}
+
+void specialize_stmts(AstList statements) {
+        specialize_stmt_list(statements);
+}
+
 void interpret_expr(const Expr *expr) {
         init();
-        printf("%s\n", stringify(evaluate_expr(expr)));
+        printf("%s\n", object_stringify(evaluate_expr(expr)));
 }
 
-void interpret_stmts(const Vector *statements) {
+void interpret_stmts(AstList statements) {
         init();
-        size_t num_statements = vector_size(statements);
-        for (size_t i = 0; i < num_statements; i++) {
-                execute_stmt(vector_at(statements, i));
+        const AstRef *refs = ast_refs(statements);
+        for (size_t i = 0; i < statements.size; i++) {
+                execute_stmt(ast_node(refs[i]));
         }
 }
 
@@ -412,24 +975,21 @@ Environment *get_globals(void) {
         return interpreter.globals;
 }
 
-Object *execute_block(Vector *statements, Environment *environment) {
+Object *execute_block(AstList statements, Environment *environment) {
         Environment *previous = interpreter.environment;
+        gc_push_root(previous);
         interpreter.environment = environment;
 
         Object *result = NULL;
-        size_t num_statements = vector_size(statements);
-        for (size_t i = 0; i < num_statements; i++) {
-                result = execute_stmt(vector_at(statements, i));
+        const AstRef *refs = ast_refs(statements);
+        for (size_t i = 0; i < statements.size; i++) {
+                result = execute_stmt(ast_node(refs[i]));
                 if (result != NULL) {
                         break;
                 }
         }
 
         interpreter.environment = previous;
+        gc_pop_roots(1);
         return result;
 }
-
-void interpreter_resolve(const Expr *expr, size_t depth) {
-        init();
-        map_put(interpreter.locals, expr, (void *)depth);
-}
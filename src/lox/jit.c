@@ -0,0 +1,645 @@
+#include "lox/jit.h"
+
+#ifdef LOX_JIT
+
+#include "lox/chunk.h"
+#include "lox/errors.h"
+#include "lox/gc.h"
+#include "lox/lox_closure.h"
+#include "lox/object.h"
+#include "lox/vm.h"
+#include "util/map.h"
+#include "util/vector.h"
+#include "util/xmalloc.h"
+
+#include <assert.h>
+#include <err.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define NO_ENTRY UINT32_MAX
+#define SIGN_BIT ((uint64_t)1 << 63)
+
+enum {
+        RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+        R8, R9, R10, R11, R12, R13, R14, R15,
+};
+
+#define FRAME RBX
+#define SLOTS R12
+#define TOP R13
+#define OFFSET R14
+#define TOP_ADDRESS R15
+
+enum {
+        CC_AE = 0x3,
+        CC_E = 0x4,
+        CC_NE = 0x5,
+        CC_A = 0x7,
+};
+
+struct JitCode {
+        const uint8_t *bytecode;
+        uint8_t *native;
+        uint32_t *entries;
+};
+
+typedef void (*NativeCode)(CallFrame *frame, Object ***stack_top, const uint8_t *entry);
+
+typedef struct {
+        uint32_t at;
+        uint32_t target;
+        bool is_exit;
+} Fixup;
+
+static struct {
+        uint8_t *code;
+        size_t size;
+        size_t capacity;
+        Fixup *fixups;
+        size_t num_fixups;
+        size_t fixups_capacity;
+        uint32_t epilogue;
+} jit;
+
+static void emit_byte(uint8_t byte) {
+        if (jit.size == jit.capacity) {
+                jit.capacity = jit.capacity == 0 ? 4096 : jit.capacity * 2;
+                jit.code = xrealloc(jit.code, jit.capacity);
+        }
+        jit.code[jit.size++] = byte;
+}
+
+static void emit_u32(uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+                emit_byte(value >> (8 * i));
+        }
+}
+
+static void emit_u64(uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+                emit_byte(value >> (8 * i));
+        }
+}
+
+static void patch_u32(size_t at, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+                jit.code[at + i] = value >> (8 * i);
+        }
+}
+
+static void emit_rex(bool wide, int reg, int base) {
+        uint8_t rex = 0x40 | wide << 3 | (reg >> 3) << 2 | (base >> 3);
+        if (rex != 0x40) {
+                emit_byte(rex);
+        }
+}
+
+static void emit_direct(int reg, int base) {
+        emit_byte(0xc0 | (reg & 7) << 3 | (base & 7));
+}
+
+static void emit_indirect(int reg, int base, int32_t displacement) {
+        emit_byte(0x80 | (reg & 7) << 3 | (base & 7));
+        if ((base & 7) == RSP) {
+                emit_byte(0x24);
+        }
+        emit_u32(displacement);
+}
+
+static void emit_load(int reg, int base, int32_t displacement) {
+        emit_rex(true, reg, base);
+        emit_byte(0x8b);
+        emit_indirect(reg, base, displacement);
+}
+
+static void emit_store(int base, int32_t displacement, int reg) {
+        emit_rex(true, reg, base);
+        emit_byte(0x89);
+        emit_indirect(reg, base, displacement);
+}
+
+static void emit_alu(uint8_t opcode, int dst, int src) {
+        emit_rex(true, src, dst);
+        emit_byte(opcode);
+        emit_direct(src, dst);
+}
+
+static void emit_mov(int dst, int src) {
+        emit_alu(0x89, dst, src);
+}
+
+static void emit_mov_imm(int reg, uint64_t imm) {
+        emit_rex(true, 0, reg);
+        emit_byte(0xb8 + (reg & 7));
+        emit_u64(imm);
+}
+
+static void emit_alu_imm(int extension, int reg, int32_t imm) {
+        emit_rex(true, 0, reg);
+        emit_byte(0x81);
+        emit_direct(extension, reg);
+        emit_u32(imm);
+}
+
+static void emit_add_imm(int reg, int32_t imm) {
+        emit_alu_imm(0, reg, imm);
+}
+
+static void emit_or_imm(int reg, int32_t imm) {
+        emit_alu_imm(1, reg, imm);
+}
+
+static void emit_sub_imm(int reg, int32_t imm) {
+        emit_alu_imm(5, reg, imm);
+}
+
+static void emit_cmp_imm(int reg, int32_t imm) {
+        emit_alu_imm(7, reg, imm);
+}
+
+static void emit_shr_imm(int reg, uint8_t imm) {
+        emit_rex(true, 0, reg);
+        emit_byte(0xc1);
+        emit_direct(5, reg);
+        emit_byte(imm);
+}
+
+static void emit_cmov(uint8_t cc, int dst, int src) {
+        emit_rex(true, dst, src);
+        emit_byte(0x0f);
+        emit_byte(0x40 | cc);
+        emit_direct(dst, src);
+}
+
+static void emit_push(int reg) {
+        emit_rex(false, 0, reg);
+        emit_byte(0x50 + (reg & 7));
+}
+
+static void emit_pop(int reg) {
+        emit_rex(false, 0, reg);
+        emit_byte(0x58 + (reg & 7));
+}
+
+static void emit_movq_to_xmm(int xmm, int reg) {
+        emit_byte(0x66);
+        emit_rex(true, xmm, reg);
+        emit_byte(0x0f);
+        emit_byte(0x6e);
+        emit_direct(xmm, reg);
+}
+
+static void emit_movq_from_xmm(int reg, int xmm) {
+        emit_byte(0x66);
+        emit_rex(true, xmm, reg);
+        emit_byte(0x0f);
+        emit_byte(0x7e);
+        emit_direct(xmm, reg);
+}
+
+static void emit_sse(uint8_t prefix, uint8_t opcode, int dst, int src) {
+        emit_byte(prefix);
+        emit_byte(0x0f);
+        emit_byte(opcode);
+        emit_direct(dst, src);
+}
+
+static void emit_call(const void *function) {
+        emit_mov_imm(RAX, (uintptr_t)function);
+        emit_byte(0xff);
+        emit_direct(2, RAX);
+}
+
+static void add_fixup(uint32_t target, bool is_exit) {
+        if (jit.num_fixups == jit.fixups_capacity) {
+                jit.fixups_capacity = jit.fixups_capacity == 0 ? 64 : jit.fixups_capacity * 2;
+                jit.fixups = xrealloc(jit.fixups, sizeof(Fixup) * jit.fixups_capacity);
+        }
+        Fixup *fixup = &jit.fixups[jit.num_fixups++];
+        fixup->at = jit.size;
+        fixup->target = target;
+        fixup->is_exit = is_exit;
+        emit_u32(0);
+}
+
+static void emit_jump(uint32_t target) {
+        emit_byte(0xe9);
+        add_fixup(target, false);
+}
+
+static void emit_branch(uint8_t cc, uint32_t target) {
+        emit_byte(0x0f);
+        emit_byte(0x80 | cc);
+        add_fixup(target, false);
+}
+
+static void emit_exit_branch(uint8_t cc, uint32_t offset) {
+        emit_byte(0x0f);
+        emit_byte(0x80 | cc);
+        add_fixup(offset, true);
+}
+
+static void emit_exit(uint32_t offset) {
+        emit_byte(0xe9);
+        add_fixup(offset, true);
+}
+
+static void emit_sync(void) {
+        emit_store(TOP_ADDRESS, 0, TOP);
+}
+
+static void emit_push_value(int reg) {
+        emit_store(TOP, 0, reg);
+        emit_add_imm(TOP, sizeof(Object *));
+}
+
+static void emit_push_imm(const Object *object) {
+        emit_mov_imm(RAX, (uintptr_t)object);
+        emit_push_value(RAX);
+}
+
+static void emit_number_guard(int reg, uint32_t offset) {
+        emit_mov(RDX, reg);
+        emit_shr_imm(RDX, 48);
+        emit_exit_branch(CC_E, offset);
+}
+
+static void emit_unbox(int xmm, int reg) {
+        emit_alu(0x29, reg, OFFSET);
+        emit_movq_to_xmm(xmm, reg);
+}
+
+static void emit_box(int reg) {
+        emit_mov_imm(RDX, CANONICAL_NAN_BITS);
+        emit_alu(0x39, reg, RDX);
+        emit_cmov(CC_AE, reg, RDX);
+        emit_alu(0x01, reg, OFFSET);
+}
+
+static void emit_number_operands(uint32_t offset) {
+        emit_load(RAX, TOP, -2 * (int32_t)sizeof(Object *));
+        emit_load(RCX, TOP, -(int32_t)sizeof(Object *));
+        emit_number_guard(RAX, offset);
+        emit_number_guard(RCX, offset);
+        emit_unbox(0, RAX);
+        emit_unbox(1, RCX);
+}
+
+static void emit_arithmetic(uint8_t opcode, uint32_t offset) {
+        emit_number_operands(offset);
+        emit_sse(0xf2, opcode, 0, 1);
+        emit_movq_from_xmm(RAX, 0);
+        emit_box(RAX);
+        emit_store(TOP, -2 * (int32_t)sizeof(Object *), RAX);
+        emit_sub_imm(TOP, sizeof(Object *));
+}
+
+static void emit_boolean(uint8_t cc, int dst) {
+        emit_mov_imm(dst, (uintptr_t)boolean_object_construct(false));
+        emit_mov_imm(RDX, (uintptr_t)boolean_object_construct(true));
+        emit_cmov(cc, dst, RDX);
+}
+
+static void emit_comparison(bool is_swapped, uint8_t cc, uint32_t offset) {
+        emit_number_operands(offset);
+        if (is_swapped) {
+                emit_sse(0x66, 0x2e, 1, 0);
+        } else {
+                emit_sse(0x66, 0x2e, 0, 1);
+        }
+        emit_boolean(cc, RAX);
+        emit_store(TOP, -2 * (int32_t)sizeof(Object *), RAX);
+        emit_sub_imm(TOP, sizeof(Object *));
+}
+
+static void emit_falsiness(int reg) {
+        emit_or_imm(reg, (uintptr_t)nil_object_construct() ^ (uintptr_t)boolean_object_construct(false));
+        emit_cmp_imm(reg, (uintptr_t)boolean_object_construct(false));
+}
+
+static void emit_equality(uint8_t cc) {
+        emit_load(RDI, TOP, -2 * (int32_t)sizeof(Object *));
+        emit_load(RSI, TOP, -(int32_t)sizeof(Object *));
+        emit_call(object_equals);
+        emit_byte(0x84);
+        emit_direct(RAX, RAX);
+        emit_boolean(cc, RCX);
+        emit_store(TOP, -2 * (int32_t)sizeof(Object *), RCX);
+        emit_sub_imm(TOP, sizeof(Object *));
+}
+
+static void emit_upvalue_location(uint16_t index) {
+        emit_load(RAX, FRAME, offsetof(CallFrame, closure));
+        emit_load(RAX, RAX, offsetof(LoxClosure, upvalues) + sizeof(Upvalue *) * index);
+        emit_load(RAX, RAX, offsetof(Upvalue, location));
+}
+
+static void emit_prologue(void) {
+        emit_push(RBX);
+        emit_push(RBP);
+        emit_push(R12);
+        emit_push(R13);
+        emit_push(R14);
+        emit_push(R15);
+        emit_sub_imm(RSP, 8);
+        emit_mov(FRAME, RDI);
+        emit_mov(TOP_ADDRESS, RSI);
+        emit_load(SLOTS, FRAME, offsetof(CallFrame, slots));
+        emit_load(TOP, TOP_ADDRESS, 0);
+        emit_mov_imm(OFFSET, NUMBER_OFFSET);
+        emit_byte(0xff);
+        emit_direct(4, RDX);
+
+        jit.epilogue = jit.size;
+        emit_sync();
+        emit_add_imm(RSP, 8);
+        emit_pop(R15);
+        emit_pop(R14);
+        emit_pop(R13);
+        emit_pop(R12);
+        emit_pop(RBP);
+        emit_pop(RBX);
+        emit_byte(0xc3);
+}
+
+static uint16_t read_u16(const uint8_t *code) {
+        return code[0] | code[1] << 8;
+}
+
+static uint32_t read_u32(const uint8_t *code) {
+        return (uint32_t)code[0] | (uint32_t)code[1] << 8 | (uint32_t)code[2] << 16 | (uint32_t)code[3] << 24;
+}
+
+static size_t instruction_length(const Chunk *chunk, size_t offset) {
+        switch (chunk->code[offset]) {
+        case OP_CALL:
+                return 2;
+        case OP_GET_LOCAL:
+        case OP_GET_UPVALUE:
+        case OP_SET_LOCAL:
+        case OP_SET_UPVALUE:
+                return 3;
+        case OP_CLASS:
+        case OP_CONSTANT:
+        case OP_DEFINE_GLOBAL:
+        case OP_GET_GLOBAL:
+        case OP_GET_PROPERTY:
+        case OP_GET_SUPER:
+        case OP_JUMP:
+        case OP_JUMP_IF_FALSE:
+        case OP_JUMP_IF_TRUE:
+        case OP_LOOP:
+        case OP_METHOD:
+        case OP_POP_JUMP_IF_FALSE:
+        case OP_SET_GLOBAL:
+        case OP_SET_PROPERTY:
+                return 5;
+        case OP_CLOSURE: {
+                const Prototype *prototype = vector_at(chunk->prototypes, read_u32(chunk->code + offset + 1));
+                return 5 + 3 * prototype->num_upvalues;
+        }
+        default:
+                return 1;
+        }
+}
+
+static Object *get_global(Map *globals, const char *name, size_t line) {
+        void *value;
+        if (!map_find(globals, name, &value)) {
+                vm_error(line, "Undefined variable '%s'.", name);
+        }
+        return value;
+}
+
+static void set_global(Map *globals, const char *name, Object *value, size_t line) {
+        if (!map_contains(globals, name)) {
+                vm_error(line, "Undefined variable '%s'.", name);
+        }
+        map_put(globals, name, value);
+}
+
+static void print_value(const Object *value) {
+        printf("%s\n", object_stringify(value));
+}
+
+static void emit_instruction(const Chunk *chunk, size_t offset, Map *globals) {
+        const uint8_t *operands = chunk->code + offset + 1;
+        size_t next = offset + instruction_length(chunk, offset);
+        size_t line = chunk->lines[offset];
+        switch (chunk->code[offset]) {
+        case OP_ADD:
+                emit_arithmetic(0x58, offset);
+                break;
+        case OP_CONSTANT:
+                emit_push_imm(vector_at(chunk->constants, read_u32(operands)));
+                break;
+        case OP_DEFINE_GLOBAL:
+                emit_sub_imm(TOP, sizeof(Object *));
+                emit_mov_imm(RDI, (uintptr_t)globals);
+                emit_mov_imm(RSI, (uintptr_t)object_as_string(vector_at(chunk->constants, read_u32(operands))));
+                emit_load(RDX, TOP, 0);
+                emit_sync();
+                emit_call(map_put);
+                break;
+        case OP_DIVIDE:
+                emit_arithmetic(0x5e, offset);
+                break;
+        case OP_EQUAL:
+                emit_equality(CC_NE);
+                break;
+        case OP_FALSE:
+                emit_push_imm(boolean_object_construct(false));
+                break;
+        case OP_GET_GLOBAL:
+                emit_mov_imm(RDI, (uintptr_t)globals);
+                emit_mov_imm(RSI, (uintptr_t)object_as_string(vector_at(chunk->constants, read_u32(operands))));
+                emit_mov_imm(RDX, line);
+                emit_sync();
+                emit_call(get_global);
+                emit_push_value(RAX);
+                break;
+        case OP_GET_LOCAL:
+                emit_load(RAX, SLOTS, sizeof(Object *) * read_u16(operands));
+                emit_push_value(RAX);
+                break;
+        case OP_GET_UPVALUE:
+                emit_upvalue_location(read_u16(operands));
+                emit_load(RAX, RAX, 0);
+                emit_push_value(RAX);
+                break;
+        case OP_GREATER:
+                emit_comparison(false, CC_A, offset);
+                break;
+        case OP_GREATER_EQUAL:
+                emit_comparison(false, CC_AE, offset);
+                break;
+        case OP_JUMP:
+                emit_jump(next + read_u32(operands));
+                break;
+        case OP_JUMP_IF_FALSE:
+                emit_load(RAX, TOP, -(int32_t)sizeof(Object *));
+                emit_falsiness(RAX);
+                emit_branch(CC_E, next + read_u32(operands));
+                break;
+        case OP_JUMP_IF_TRUE:
+                emit_load(RAX, TOP, -(int32_t)sizeof(Object *));
+                emit_falsiness(RAX);
+                emit_branch(CC_NE, next + read_u32(operands));
+                break;
+        case OP_LESS:
+                emit_comparison(true, CC_A, offset);
+                break;
+        case OP_LESS_EQUAL:
+                emit_comparison(true, CC_AE, offset);
+                break;
+        case OP_LOOP:
+                emit_sync();
+                emit_call(gc_maybe_collect);
+                emit_jump(next - read_u32(operands));
+                break;
+        case OP_MULTIPLY:
+                emit_arithmetic(0x59, offset);
+                break;
+        case OP_NEGATE:
+                emit_load(RAX, TOP, -(int32_t)sizeof(Object *));
+                emit_number_guard(RAX, offset);
+                emit_alu(0x29, RAX, OFFSET);
+                emit_mov_imm(RCX, SIGN_BIT);
+                emit_alu(0x31, RAX, RCX);
+                emit_box(RAX);
+                emit_store(TOP, -(int32_t)sizeof(Object *), RAX);
+                break;
+        case OP_NIL:
+                emit_push_imm(nil_object_construct());
+                break;
+        case OP_NOT:
+                emit_load(RAX, TOP, -(int32_t)sizeof(Object *));
+                emit_falsiness(RAX);
+                emit_boolean(CC_E, RAX);
+                emit_store(TOP, -(int32_t)sizeof(Object *), RAX);
+                break;
+        case OP_NOT_EQUAL:
+                emit_equality(CC_E);
+                break;
+        case OP_POP:
+                emit_sub_imm(TOP, sizeof(Object *));
+                break;
+        case OP_POP_JUMP_IF_FALSE:
+                emit_sub_imm(TOP, sizeof(Object *));
+                emit_load(RAX, TOP, 0);
+                emit_falsiness(RAX);
+                emit_branch(CC_E, next + read_u32(operands));
+                break;
+        case OP_PRINT:
+                emit_sub_imm(TOP, sizeof(Object *));
+                emit_load(RDI, TOP, 0);
+                emit_sync();
+                emit_call(print_value);
+                break;
+        case OP_SET_GLOBAL:
+                emit_mov_imm(RDI, (uintptr_t)globals);
+                emit_mov_imm(RSI, (uintptr_t)object_as_string(vector_at(chunk->constants, read_u32(operands))));
+                emit_load(RDX, TOP, -(int32_t)sizeof(Object *));
+                emit_mov_imm(RCX, line);
+                emit_sync();
+                emit_call(set_global);
+                break;
+        case OP_SET_LOCAL:
+                emit_load(RAX, TOP, -(int32_t)sizeof(Object *));
+                emit_store(SLOTS, sizeof(Object *) * read_u16(operands), RAX);
+                break;
+        case OP_SET_UPVALUE:
+                emit_upvalue_location(read_u16(operands));
+                emit_load(RCX, TOP, -(int32_t)sizeof(Object *));
+                emit_store(RAX, 0, RCX);
+                break;
+        case OP_SUBTRACT:
+                emit_arithmetic(0x5c, offset);
+                break;
+        case OP_TRUE:
+                emit_push_imm(boolean_object_construct(true));
+                break;
+        default:
+                emit_exit(offset);
+                break;
+        }
+}
+
+static uint8_t *install(void) {
+        size_t page_size = sysconf(_SC_PAGESIZE);
+        size_t length = (jit.size + page_size - 1) / page_size * page_size;
+        uint8_t *native = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (native == MAP_FAILED) {
+                err(EXIT_FAILURE, "mmap");
+        }
+        memcpy(native, jit.code, jit.size);
+        if (mprotect(native, length, PROT_READ | PROT_EXEC) < 0) {
+                err(EXIT_FAILURE, "mprotect");
+        }
+        return native;
+}
+
+JitCode *jit_compile(const Prototype *prototype, Map *globals) {
+        const Chunk *chunk = &prototype->chunk;
+        jit.size = 0;
+        jit.num_fixups = 0;
+
+        JitCode *jit_code = xmalloc(sizeof(JitCode));
+        jit_code->bytecode = chunk->code;
+        jit_code->entries = xmalloc(sizeof(uint32_t) * (chunk->size + 1));
+        for (size_t offset = 0; offset <= chunk->size; offset++) {
+                jit_code->entries[offset] = NO_ENTRY;
+        }
+
+        emit_prologue();
+        for (size_t offset = 0; offset < chunk->size; offset += instruction_length(chunk, offset)) {
+                jit_code->entries[offset] = jit.size;
+                emit_instruction(chunk, offset, globals);
+        }
+        jit_code->entries[chunk->size] = jit.size;
+        emit_exit(chunk->size);
+
+        size_t num_fixups = jit.num_fixups;
+        uint32_t *exits = xmalloc(sizeof(uint32_t) * (chunk->size + 1));
+        for (size_t offset = 0; offset <= chunk->size; offset++) {
+                exits[offset] = NO_ENTRY;
+        }
+        for (size_t i = 0; i < num_fixups; i++) {
+                const Fixup *fixup = &jit.fixups[i];
+                uint32_t target;
+                if (fixup->is_exit) {
+                        if (exits[fixup->target] == NO_ENTRY) {
+                                exits[fixup->target] = jit.size;
+                                emit_mov_imm(RAX, (uintptr_t)(chunk->code + fixup->target));
+                                emit_store(FRAME, offsetof(CallFrame, ip), RAX);
+                                emit_byte(0xe9);
+                                emit_u32(jit.epilogue - (jit.size + 4));
+                        }
+                        target = exits[fixup->target];
+                } else {
+                        target = jit_code->entries[fixup->target];
+                        assert(target != NO_ENTRY);
+                }
+                patch_u32(fixup->at, target - (fixup->at + 4));
+        }
+        free(exits);
+
+        jit_code->native = install();
+        return jit_code;
+}
+
+void jit_execute(const JitCode *jit_code, CallFrame *frame, Object ***stack_top) {
+        uint32_t entry = jit_code->entries[frame->ip - jit_code->bytecode];
+        assert(entry != NO_ENTRY);
+        NativeCode native = (NativeCode)jit_code->native;
+        native(frame, stack_top, jit_code->native + entry);
+}
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef CODECRAFTERS_INTERPRETER_LOX_JIT_H
+#define CODECRAFTERS_INTERPRETER_LOX_JIT_H
+
+#include "lox/chunk.h"
+#include "lox/object.h"
+#include "lox/vm.h"
+#include "util/map.h"
+
+JitCode *jit_compile(const Prototype *prototype, Map *globals);
+void jit_execute(const JitCode *jit_code, CallFrame *frame, Object ***stack_top);
+
+#endif
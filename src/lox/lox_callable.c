@@ -1,15 +1,17 @@
 #include "lox/lox_callable.h"
+#include "lox/gc.h"
 #include "lox/lox_class.h"
+#include "lox/lox_closure.h"
 #include "lox/lox_function.h"
 #include "lox/object.h"
-#include "util/vector.h"
-#include "util/xmalloc.h"
 
+#include <err.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 
 LoxClock *lox_clock_construct(void) {
-        LoxClock *lox_clock = xmalloc(sizeof(LoxClock));
+        LoxClock *lox_clock = gc_allocate_permanent(sizeof(LoxClock));
         lox_clock->base.type = LOX_CALLABLE_CLOCK;
         return lox_clock;
 }
@@ -17,10 +19,14 @@ LoxClock *lox_clock_construct(void) {
 const char *lox_callable_to_string(const LoxCallable *callable) {
         static char str[256];
         switch (callable->type) {
+        case LOX_CALLABLE_BOUND_METHOD:
+                return lox_closure_to_string(((const LoxBoundMethod *)callable)->method);
         case LOX_CALLABLE_CLASS:
                 return lox_class_to_string((const LoxClass *)callable);
         case LOX_CALLABLE_CLOCK:
                 return "<native fn>";
+        case LOX_CALLABLE_CLOSURE:
+                return lox_closure_to_string((const LoxClosure *)callable);
         case LOX_CALLABLE_FUNCTION:
                 return lox_function_to_string((const LoxFunction *)callable);
         }
@@ -28,17 +34,24 @@ const char *lox_callable_to_string(const LoxCallable *callable) {
 
 size_t lox_callable_arity(const LoxCallable *callable) {
         switch (callable->type) {
+        case LOX_CALLABLE_BOUND_METHOD:
+                return ((const LoxBoundMethod *)callable)->method->prototype->arity;
         case LOX_CALLABLE_CLASS:
                 return lox_class_arity((const LoxClass *)callable);
         case LOX_CALLABLE_CLOCK:
                 return 0;
+        case LOX_CALLABLE_CLOSURE:
+                return ((const LoxClosure *)callable)->prototype->arity;
         case LOX_CALLABLE_FUNCTION:
                 return lox_function_arity((const LoxFunction *)callable);
         }
 }
 
-Object *lox_callable_call(LoxCallable *callable, Vector *arguments) {
+Object *lox_callable_call(LoxCallable *callable, Object **arguments) {
         switch (callable->type) {
+        case LOX_CALLABLE_BOUND_METHOD:
+        case LOX_CALLABLE_CLOSURE:
+                errx(EXIT_FAILURE, "bytecode callables can only be called by the vm");
         case LOX_CALLABLE_CLASS:
                 return lox_class_call((LoxClass *)callable, arguments);
         case LOX_CALLABLE_CLOCK:
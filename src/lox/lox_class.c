@@ -1,18 +1,24 @@
 #include "lox/lox_class.h"
+#include "lox/gc.h"
 #include "lox/lox_callable.h"
 #include "lox/lox_function.h"
 #include "lox/lox_instance.h"
+#include "util/intern.h"
 #include "util/map.h"
-#include "util/xmalloc.h"
 
 #include <string.h>
 
 LoxClass *lox_class_construct(const char *name, LoxClass *superclass, Map *methods) {
-        LoxClass *class = xmalloc(sizeof(LoxClass));
+        LoxClass *class = gc_allocate(GC_CLASS, sizeof(LoxClass));
         class->base.type = LOX_CALLABLE_CLASS;
         class->name = name;
         class->superclass = superclass;
         class->methods = methods;
+        class->initializer = NULL;
+        void *initializer;
+        if (map_find(methods, intern_string("init"), &initializer)) {
+                class->initializer = initializer;
+        }
         return class;
 }
 
@@ -21,25 +27,19 @@ const char *lox_class_to_string(const LoxClass *class) {
 }
 
 size_t lox_class_arity(const LoxClass *class) {
-        LoxFunction *initializer = lox_class_find_method(class, "init");
+        const LoxFunction *initializer = (const LoxFunction *)class->initializer;
         return initializer == NULL ? 0 : lox_function_arity(initializer);
 }
 
-Object *lox_class_call(LoxClass *class, Vector *arguments) {
-        LoxInstance *instance = lox_instance_construct(class);
-        LoxFunction *initializer = lox_class_find_method(class, "init");
-        if (initializer != NULL) {
-                LoxFunction *function = lox_function_bind(initializer, instance);
-                lox_function_call(function, arguments);
+Object *lox_class_call(LoxClass *class, Object **arguments) {
+        Object *instance = lox_instance_object_construct(lox_instance_construct(class));
+        if (class->initializer != NULL) {
+                lox_function_invoke((LoxFunction *)class->initializer, instance, arguments);
         }
-        return lox_instance_object_construct(instance);
+        return instance;
 }
 
 LoxFunction *lox_class_find_method(const LoxClass *class, const char *name) {
-        if (map_contains(class->methods, name)) {
-                return map_get(class->methods, name);
-        } else if (class->superclass != NULL) {
-                return lox_class_find_method(class->superclass, name);
-        }
-        return NULL;
+        void *method;
+        return map_find(class->methods, name, &method) ? method : NULL;
 }
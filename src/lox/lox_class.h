@@ -13,12 +13,13 @@ struct LoxClass {
         const char *name;
         LoxClass *superclass;
         Map *methods;
+        LoxCallable *initializer;
 };
 
 LoxClass *lox_class_construct(const char *name, LoxClass *superclass, Map *methods);
 const char *lox_class_to_string(const LoxClass *class);
 size_t lox_class_arity(const LoxClass *class);
-Object *lox_class_call(LoxClass *class, Vector *arguments);
+Object *lox_class_call(LoxClass *class, Object **arguments);
 
 LoxFunction *lox_class_find_method(const LoxClass *class, const char *name);
 
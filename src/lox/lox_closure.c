@@ -0,0 +1,39 @@
+#include "lox/lox_closure.h"
+#include "lox/chunk.h"
+#include "lox/gc.h"
+#include "lox/lox_callable.h"
+#include "lox/object.h"
+
+#include <stdio.h>
+
+Upvalue *upvalue_construct(Object **location) {
+        Upvalue *upvalue = gc_allocate(GC_UPVALUE, sizeof(Upvalue));
+        upvalue->location = location;
+        upvalue->closed = NULL;
+        upvalue->next = NULL;
+        return upvalue;
+}
+
+LoxClosure *lox_closure_construct(Prototype *prototype) {
+        LoxClosure *closure = gc_allocate(GC_CLOSURE, sizeof(LoxClosure) + sizeof(Upvalue *) * prototype->num_upvalues);
+        closure->base.type = LOX_CALLABLE_CLOSURE;
+        closure->prototype = prototype;
+        for (size_t i = 0; i < prototype->num_upvalues; i++) {
+                closure->upvalues[i] = NULL;
+        }
+        return closure;
+}
+
+const char *lox_closure_to_string(const LoxClosure *closure) {
+        static char str[256];
+        snprintf(str, sizeof(str), "<fn %s>", closure->prototype->name);
+        return str;
+}
+
+LoxBoundMethod *lox_bound_method_construct(Object *receiver, LoxClosure *method) {
+        LoxBoundMethod *bound_method = gc_allocate(GC_BOUND_METHOD, sizeof(LoxBoundMethod));
+        bound_method->base.type = LOX_CALLABLE_BOUND_METHOD;
+        bound_method->receiver = receiver;
+        bound_method->method = method;
+        return bound_method;
+}
@@ -0,0 +1,34 @@
+#ifndef CODECRAFTERS_INTERPRETER_LOX_CLOSURE_H
+#define CODECRAFTERS_INTERPRETER_LOX_CLOSURE_H
+
+#include "lox/chunk.h"
+#include "lox/lox_callable.h"
+#include "lox/object.h"
+
+typedef struct Upvalue Upvalue;
+struct Upvalue {
+        Object **location;
+        Object *closed;
+        Upvalue *next;
+};
+
+Upvalue *upvalue_construct(Object **location);
+
+typedef struct {
+        LoxCallable base;
+        Prototype *prototype;
+        Upvalue *upvalues[];
+} LoxClosure;
+
+LoxClosure *lox_closure_construct(Prototype *prototype);
+const char *lox_closure_to_string(const LoxClosure *closure);
+
+typedef struct {
+        LoxCallable base;
+        Object *receiver;
+        LoxClosure *method;
+} LoxBoundMethod;
+
+LoxBoundMethod *lox_bound_method_construct(Object *receiver, LoxClosure *method);
+
+#endif
@@ -1,44 +1,57 @@
 #include "lox/lox_function.h"
 #include "lox/environment.h"
+#include "lox/gc.h"
 #include "lox/interpreter.h"
 #include "lox/lox_callable.h"
 #include "lox/object.h"
-#include "util/vector.h"
-#include "util/xmalloc.h"
 
 #include <stdio.h>
+#include <string.h>
 
 LoxFunction *lox_function_construct(const FunctionStmt *declaration, Environment *closure, bool is_initializer) {
-        LoxFunction *function = xmalloc(sizeof(LoxFunction));
+        LoxFunction *function = gc_allocate(GC_FUNCTION, sizeof(LoxFunction));
         function->base.type = LOX_CALLABLE_FUNCTION;
         function->declaration = declaration;
         function->closure = closure;
+        function->receiver = NULL;
         function->is_initializer = is_initializer;
         return function;
 }
 
 const char *lox_function_to_string(const LoxFunction *function) {
         static char str[256];
-        snprintf(str, sizeof(str), "<fn %s>", function->declaration->name->lexeme);
+        snprintf(str, sizeof(str), "<fn %s>", function->declaration->name);
         return str;
 }
 
 size_t lox_function_arity(const LoxFunction *function) {
-        return vector_size(function->declaration->params);
+        return function->declaration->params.size;
 }
 
-Object *lox_function_call(LoxFunction *lox_function, Vector *arguments) {
-        Environment *environment = environment_construct(lox_function->closure);
+LoxFunction *lox_function_bind(LoxFunction *function, Object *receiver) {
+        LoxFunction *bound = lox_function_construct(function->declaration, function->closure, function->is_initializer);
+        bound->receiver = receiver;
+        return bound;
+}
+
+Object *lox_function_call(LoxFunction *lox_function, Object **arguments) {
+        return lox_function_invoke(lox_function, lox_function->receiver, arguments);
+}
 
-        size_t num_params = vector_size(lox_function->declaration->params);
-        for (size_t i = 0; i < num_params; i++) {
-                Token *param = vector_at(lox_function->declaration->params, i);
-                environment_define(environment, param->lexeme, vector_at(arguments, i));
+Object *lox_function_invoke(LoxFunction *lox_function, Object *receiver, Object **arguments) {
+        const FunctionStmt *declaration = lox_function->declaration;
+        Environment *environment = environment_construct(lox_function->closure, declaration->num_slots);
+        size_t num_params = declaration->params.size;
+        memcpy(environment->slots, arguments, sizeof(Object *) * num_params);
+        if (receiver != NULL) {
+                environment->slots[num_params] = receiver;
         }
 
-        Object *result = execute_block(lox_function->declaration->body, environment);
+        gc_push_root(lox_function);
+        Object *result = execute_block(declaration->body, environment);
+        gc_pop_roots(1);
         if (lox_function->is_initializer) {
-                return environment_get_at(lox_function->closure, "this", 0);
+                return receiver;
         }
         return result == NULL ? nil_object_construct() : result;
 }
@@ -5,18 +5,20 @@
 #include "lox/lox_callable.h"
 #include "lox/object.h"
 #include "lox/stmt.h"
-#include "util/vector.h"
 
 typedef struct {
         LoxCallable base;
         const FunctionStmt *declaration;
         Environment *closure;
+        Object *receiver;
         bool is_initializer;
 } LoxFunction;
 
 LoxFunction *lox_function_construct(const FunctionStmt *declaration, Environment *closure, bool is_initializer);
 const char *lox_function_to_string(const LoxFunction *function);
 size_t lox_function_arity(const LoxFunction *function);
-Object *lox_function_call(LoxFunction *function, Vector *arguments);
+LoxFunction *lox_function_bind(LoxFunction *function, Object *receiver);
+Object *lox_function_call(LoxFunction *function, Object **arguments);
+Object *lox_function_invoke(LoxFunction *function, Object *receiver, Object **arguments);
 
 #endif
@@ -1,26 +1,25 @@
 #include "lox/lox_instance.h"
 #include "lox/environment.h"
 #include "lox/errors.h"
+#include "lox/gc.h"
+#include "lox/inline_cache.h"
 #include "lox/lox_callable.h"
 #include "lox/lox_class.h"
 #include "lox/lox_function.h"
 #include "lox/object.h"
+#include "lox/shape.h"
 #include "lox/token.h"
-#include "util/map.h"
 #include "util/xmalloc.h"
 
 #include <stdio.h>
 #include <string.h>
 
-struct LoxInstance {
-        LoxClass *class;
-        Map *fields;
-};
-
 LoxInstance *lox_instance_construct(LoxClass *class) {
-        LoxInstance *instance = xmalloc(sizeof(LoxInstance));
+        LoxInstance *instance = gc_allocate(GC_INSTANCE, sizeof(LoxInstance));
         instance->class = class;
-        instance->fields = map_construct(str_compare);
+        instance->shape = shape_root();
+        instance->fields = NULL;
+        instance->fields_capacity = 0;
         return instance;
 }
 
@@ -30,25 +29,82 @@ const char *lox_instance_to_string(const LoxInstance *instance) {
         return str;
 }
 
-LoxFunction *lox_function_bind(LoxFunction *function, LoxInstance *instance) {
-        Environment *environment = environment_construct(function->closure);
-        environment_define(environment, "this", lox_instance_object_construct(instance));
-        return lox_function_construct(function->declaration, environment, function->is_initializer);
+static void store_field(LoxInstance *instance, Shape *shape, size_t slot, Object *value) {
+        if (shape->num_fields > instance->fields_capacity) {
+                instance->fields_capacity = instance->fields_capacity == 0 ? 4 : instance->fields_capacity * 2;
+                instance->fields = xrealloc(instance->fields, sizeof(Object *) * instance->fields_capacity);
+        }
+        instance->shape = shape;
+        instance->fields[slot] = value;
 }
 
-Object *lox_instance_get(LoxInstance *instance, const Token *name) {
-        if (map_contains(instance->fields, name->lexeme)) {
-                return map_get(instance->fields, name->lexeme);
+bool lox_instance_find_field(const LoxInstance *instance, const char *name, Object **value) {
+        size_t slot;
+        if (shape_find(instance->shape, name, &slot)) {
+                *value = instance->fields[slot];
+                return true;
         }
+        return false;
+}
 
-        LoxFunction *method = lox_class_find_method(instance->class, name->lexeme);
-        if (method != NULL) {
-                return lox_callable_object_construct((LoxCallable *)lox_function_bind(method, instance));
+void lox_instance_set_field(LoxInstance *instance, const char *name, Object *value) {
+        size_t slot;
+        if (shape_find(instance->shape, name, &slot)) {
+                instance->fields[slot] = value;
+                return;
         }
+        Shape *shape = shape_transition(instance->shape, name);
+        store_field(instance, shape, shape->num_fields - 1, value);
+}
 
-        interpret_error(name, "Undefined property '%s'.", name->lexeme);
+bool lox_instance_get_field(const LoxInstance *instance, const char *name, InlineCache *field_cache, Object **value) {
+        size_t slot;
+        const InlineCacheEntry *entry = inline_cache_find(field_cache, instance->shape);
+        if (entry != NULL) {
+                slot = entry->index;
+        } else {
+                if (!shape_find(instance->shape, name, &slot)) {
+                        slot = SHAPE_NO_SLOT;
+                }
+                inline_cache_put(field_cache, instance->shape, NULL, slot);
+        }
+        if (slot == SHAPE_NO_SLOT) {
+                return false;
+        }
+        *value = instance->fields[slot];
+        return true;
 }
 
-void lox_instance_set(LoxInstance *instance, const Token *name, Object *value) {
-        map_put(instance->fields, name->lexeme, value);
+LoxFunction *lox_instance_get_method(const LoxInstance *instance, const char *name, size_t line, InlineCache *method_cache) {
+        LoxFunction *method;
+        const InlineCacheEntry *entry = inline_cache_find_class(method_cache, instance->class);
+        if (entry != NULL) {
+                method = entry->value;
+        } else {
+                method = lox_class_find_method(instance->class, name);
+                if (method != NULL) {
+                        inline_cache_put(method_cache, instance->class, method, 0);
+                }
+        }
+        if (method == NULL) {
+                interpret_error(line, "Undefined property '%s'.", name);
+        }
+        return method;
+}
+
+void lox_instance_set(LoxInstance *instance, const char *name, Object *value, InlineCache *cache) {
+        const InlineCacheEntry *entry = inline_cache_find(cache, instance->shape);
+        if (entry != NULL) {
+                store_field(instance, entry->value, entry->index, value);
+                return;
+        }
+
+        Shape *shape = instance->shape;
+        size_t slot;
+        if (!shape_find(shape, name, &slot)) {
+                shape = shape_transition(shape, name);
+                slot = shape->num_fields - 1;
+        }
+        inline_cache_put(cache, instance->shape, shape, slot);
+        store_field(instance, shape, slot, value);
 }
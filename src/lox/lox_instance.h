@@ -1,18 +1,26 @@
 #ifndef CODECRAFTERS_INTERPRETER_LOX_INSTANCE_H
 #define CODECRAFTERS_INTERPRETER_LOX_INSTANCE_H
 
+#include "lox/inline_cache.h"
 #include "lox/lox_class.h"
 #include "lox/object.h"
-#include "lox/token.h"
+#include "lox/shape.h"
 
 typedef struct LoxInstance LoxInstance;
+struct LoxInstance {
+        LoxClass *class;
+        Shape *shape;
+        Object **fields;
+        size_t fields_capacity;
+};
 
 LoxInstance *lox_instance_construct(LoxClass *class);
 const char *lox_instance_to_string(const LoxInstance *instance);
-Object *lox_instance_get(LoxInstance *instance, const Token *name);
-void lox_instance_set(LoxInstance *instance, const Token *name, Object *value);
-
-LoxFunction *lox_function_bind(LoxFunction *function, LoxInstance *instance);
+bool lox_instance_find_field(const LoxInstance *instance, const char *name, Object **value);
+void lox_instance_set_field(LoxInstance *instance, const char *name, Object *value);
+bool lox_instance_get_field(const LoxInstance *instance, const char *name, InlineCache *field_cache, Object **value);
+LoxFunction *lox_instance_get_method(const LoxInstance *instance, const char *name, size_t line, InlineCache *method_cache);
+void lox_instance_set(LoxInstance *instance, const char *name, Object *value, InlineCache *cache);
 
 Object *lox_instance_object_construct(LoxInstance *instance);
 bool object_is_lox_instance(const Object *object);
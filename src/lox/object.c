@@ -1,90 +1,75 @@
 #include "lox/object.h"
+#include "lox/gc.h"
 #include "lox/lox_callable.h"
 #include "lox/lox_instance.h"
-#include "util/xmalloc.h"
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#define NIL_BITS 0x2
+#define FALSE_BITS 0x6
+#define TRUE_BITS 0x7
+
 typedef enum {
-        OBJECT_BOOLEAN,
         OBJECT_LOX_CALLABLE,
         OBJECT_LOX_INSTANCE,
-        OBJECT_NIL,
-        OBJECT_NUMBER,
         OBJECT_STRING,
 } ObjectType;
 
 struct Object {
         ObjectType type;
         union {
-                bool boolean;
-                double number;
-                char *string;
+                const char *string;
                 LoxCallable *callable;
                 LoxInstance *instance;
         } data;
 };
 
-Object *boolean_object_construct(bool boolean) {
-        if (boolean) {
-                static Object *true_object = NULL;
-                if (true_object == NULL) {
-                        true_object = xmalloc(sizeof(Object));
-                        true_object->type = OBJECT_BOOLEAN;
-                        true_object->data.boolean = true;
-                }
-                return true_object;
-        }
+static uint64_t bits_of(const Object *object) {
+        return (uintptr_t)object;
+}
 
-        static Object *false_object = NULL;
-        if (false_object == NULL) {
-                false_object = xmalloc(sizeof(Object));
-                false_object->type = OBJECT_BOOLEAN;
-                false_object->data.boolean = false;
-        }
-        return false_object;
+static Object *from_bits(uint64_t bits) {
+        return (Object *)(uintptr_t)bits;
+}
+
+Object *boolean_object_construct(bool boolean) {
+        return from_bits(boolean ? TRUE_BITS : FALSE_BITS);
 }
 
 Object *lox_callable_object_construct(LoxCallable *callable) {
-        Object *object = xmalloc(sizeof(Object));
+        Object *object = gc_allocate(GC_OBJECT, sizeof(Object));
         object->type = OBJECT_LOX_CALLABLE;
         object->data.callable = callable;
         return object;
 }
 
 Object *lox_instance_object_construct(LoxInstance *instance) {
-        Object *object = xmalloc(sizeof(Object));
+        Object *object = gc_allocate(GC_OBJECT, sizeof(Object));
         object->type = OBJECT_LOX_INSTANCE;
         object->data.instance = instance;
         return object;
 }
 
 Object *nil_object_construct(void) {
-        static Object *nil_object = NULL;
-        if (nil_object == NULL) {
-                nil_object = xmalloc(sizeof(Object));
-                nil_object->type = OBJECT_NIL;
-        }
-        return nil_object;
-}
-
-Object *number_object_construct(double number) {
-        Object *object = xmalloc(sizeof(Object));
-        object->type = OBJECT_NUMBER;
-        object->data.number = number;
-        return object;
+        return from_bits(NIL_BITS);
 }
 
-Object *string_object_construct(char *string) {
-        Object *object = xmalloc(sizeof(Object));
+Object *string_object_construct(const char *string) {
+        Object *object = gc_allocate(GC_OBJECT, sizeof(Object));
         object->type = OBJECT_STRING;
         object->data.string = string;
         return object;
 }
 
+bool object_is_immediate(const Object *object) {
+        uint64_t bits = bits_of(object);
+        return bits >> 48 != 0 || bits <= TRUE_BITS;
+}
+
 static const char *number_to_string(double number) {
         static char str[256];
         snprintf(str, sizeof(str), "%lf", number);
@@ -96,63 +81,63 @@ static const char *number_to_string(double number) {
 }
 
 const char *object_to_string(const Object *object) {
+        if (object_is_number(object)) {
+                return number_to_string(object_as_number(object));
+        }
+        switch (bits_of(object)) {
+        case FALSE_BITS:
+                return "false";
+        case NIL_BITS:
+                return "nil";
+        case TRUE_BITS:
+                return "true";
+        }
+
         switch (object->type) {
-        case OBJECT_BOOLEAN:
-                return object->data.boolean ? "true" : "false";
         case OBJECT_LOX_CALLABLE:
                 return lox_callable_to_string(object->data.callable);
         case OBJECT_LOX_INSTANCE:
                 return lox_instance_to_string(object->data.instance);
-        case OBJECT_NIL:
-                return "nil";
-        case OBJECT_NUMBER:
-                return number_to_string(object->data.number);
         case OBJECT_STRING:
                 return object->data.string;
         }
 }
 
-bool object_is_truthy(const Object *object) {
-        switch (object->type) {
-        case OBJECT_BOOLEAN:
-                return object->data.boolean;
-        case OBJECT_NIL:
-                return false;
-        default:
-                return true;
-        }
-}
+const char *object_stringify(const Object *object) {
+        static char str[256];
+        snprintf(str, sizeof(str), "%s", object_to_string(object));
 
-bool object_equals(const Object *object, const Object *other) {
-        if (object->type != other->type) {
-                return false;
+        if (object_is_number(object)) {
+                size_t n = strlen(str);
+                char *p = str + n - 2;
+                if (n >= 2 && strcmp(p, ".0") == 0) {
+                        *p = '\0';
+                }
         }
 
-        switch (object->type) {
-        case OBJECT_BOOLEAN:
-                return object->data.boolean == other->data.boolean;
-        case OBJECT_NIL:
-                return true;
-        case OBJECT_NUMBER:
-                return object->data.number == other->data.number;
-        case OBJECT_STRING:
-                return strcmp(object->data.string, other->data.string) == 0;
-        default:
-                return false;
-        }
+        return str;
 }
 
-bool object_is_number(const Object *object) {
-        return object->type == OBJECT_NUMBER;
+bool object_is_truthy(const Object *object) {
+        uint64_t bits = bits_of(object);
+        return bits != NIL_BITS && bits != FALSE_BITS;
 }
 
-double object_as_number(const Object *object) {
-        assert(object_is_number(object));
-        return object->data.number;
+bool object_equals(const Object *object, const Object *other) {
+        if (object_is_number(object) || object_is_number(other)) {
+                return object_is_number(object) && object_is_number(other) && object_as_number(object) == object_as_number(other);
+        }
+        if (object_is_immediate(object) || object_is_immediate(other)) {
+                return object == other;
+        }
+        if (object->type != OBJECT_STRING || other->type != OBJECT_STRING) {
+                return false;
+        }
+        return object->data.string == other->data.string || strcmp(object->data.string, other->data.string) == 0;
 }
 
 bool object_is_string(const Object *object) {
-        return object->type == OBJECT_STRING;
+        return !object_is_immediate(object) && object->type == OBJECT_STRING;
 }
 
 const char *object_as_string(const Object *object) {
@@ -160,8 +145,20 @@ const char *object_as_string(const Object *object) {
         return object->data.string;
 }
 
+Object *string_object_concat(const Object *left, const Object *right) {
+        const char *s1 = object_as_string(left);
+        const char *s2 = object_as_string(right);
+        size_t size = strlen(s1) + strlen(s2) + 1;
+        Object *object = gc_allocate(GC_OBJECT, sizeof(Object) + size);
+        char *res = (char *)(object + 1);
+        snprintf(res, size, "%s%s", s1, s2);
+        object->type = OBJECT_STRING;
+        object->data.string = res;
+        return object;
+}
+
 bool object_is_lox_callable(const Object *object) {
-        return object->type == OBJECT_LOX_CALLABLE;
+        return !object_is_immediate(object) && object->type == OBJECT_LOX_CALLABLE;
 }
 
 LoxCallable *object_as_lox_callable(const Object *object) {
@@ -170,7 +167,7 @@ LoxCallable *object_as_lox_callable(const Object *object) {
 }
 
 bool object_is_lox_instance(const Object *object) {
-        return object->type == OBJECT_LOX_INSTANCE;
+        return !object_is_immediate(object) && object->type == OBJECT_LOX_INSTANCE;
 }
 
 LoxInstance *object_as_lox_instance(const Object *object) {
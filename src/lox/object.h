@@ -1,23 +1,49 @@
 #ifndef CODECRAFTERS_INTERPRETER_LOX_OBJECT_H
 #define CODECRAFTERS_INTERPRETER_LOX_OBJECT_H
 
+#include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define NUMBER_OFFSET ((uint64_t)1 << 49)
+#define CANONICAL_NAN_BITS 0xfff8000000000000u
 
 typedef struct Object Object;
 
 Object *boolean_object_construct(bool boolean);
 Object *nil_object_construct(void);
-Object *number_object_construct(double number);
-Object *string_object_construct(char *string);
+Object *string_object_construct(const char *string);
+bool object_is_immediate(const Object *object);
 const char *object_to_string(const Object *object);
+const char *object_stringify(const Object *object);
 
 bool object_is_truthy(const Object *object);
 bool object_equals(const Object *object, const Object *other);
 
-bool object_is_number(const Object *object);
-double object_as_number(const Object *object);
+static inline Object *number_object_construct(double number) {
+        uint64_t bits;
+        memcpy(&bits, &number, sizeof(bits));
+        if (bits >= CANONICAL_NAN_BITS) {
+                bits = CANONICAL_NAN_BITS;
+        }
+        return (Object *)(uintptr_t)(bits + NUMBER_OFFSET);
+}
+
+static inline bool object_is_number(const Object *object) {
+        return (uintptr_t)object >> 48 != 0;
+}
+
+static inline double object_as_number(const Object *object) {
+        assert(object_is_number(object));
+        uint64_t bits = (uintptr_t)object - NUMBER_OFFSET;
+        double number;
+        memcpy(&number, &bits, sizeof(number));
+        return number;
+}
 
 bool object_is_string(const Object *object);
 const char *object_as_string(const Object *object);
+Object *string_object_concat(const Object *left, const Object *right);
 
 #endif
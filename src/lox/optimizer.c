@@ -0,0 +1,289 @@
+#include "lox/optimizer.h"
+#include "lox/ast.h"
+#include "lox/expr.h"
+#include "lox/object.h"
+#include "lox/stmt.h"
+
+#include <stdbool.h>
+
+static AstRef fold_expr(AstRef ref);
+static AstRef fold_stmt(AstRef ref);
+static AstList fold_stmt_list(AstList statements);
+
+static bool is_literal(AstRef ref) {
+        const Expr *expr = ast_node(ref);
+        return expr->type == EXPR_LITERAL;
+}
+
+static Object *literal_value(AstRef ref) {
+        const LiteralExpr *literal_expr = ast_node(ref);
+        return literal_expr->value;
+}
+
+static AstRef literal(Object *value) {
+        return ast_ref(literal_expr_construct(value));
+}
+
+static AstRef empty_block(void) {
+        return ast_ref(block_stmt_construct(ast_list_end(ast_list_begin())));
+}
+
+static AstRef fold_assign_expr(AstRef ref) {
+        AssignExpr *assign_expr = ast_node(ref);
+        assign_expr->value = fold_expr(assign_expr->value);
+        return ref;
+}
+
+static Object *fold_binary_operator(TokenType operator, const Object *left, const Object *right) {
+        switch (operator) {
+        case TOKEN_BANG_EQUAL:
+                return boolean_object_construct(!object_equals(left, right));
+        case TOKEN_EQUAL_EQUAL:
+                return boolean_object_construct(object_equals(left, right));
+        case TOKEN_PLUS:
+                if (object_is_string(left) && object_is_string(right)) {
+                        return string_object_concat(left, right);
+                }
+                break;
+        default:
+                break;
+        }
+
+        if (!object_is_number(left) || !object_is_number(right)) {
+                return NULL;
+        }
+        double a = object_as_number(left), b = object_as_number(right);
+        switch (operator) {
+        case TOKEN_GREATER:
+                return boolean_object_construct(a > b);
+        case TOKEN_GREATER_EQUAL:
+                return boolean_object_construct(a >= b);
+        case TOKEN_LESS:
+                return boolean_object_construct(a < b);
+        case TOKEN_LESS_EQUAL:
+                return boolean_object_construct(a <= b);
+        case TOKEN_MINUS:
+                return number_object_construct(a - b);
+        case TOKEN_PLUS:
+                return number_object_construct(a + b);
+        case TOKEN_SLASH:
+                return number_object_construct(a / b);
+        case TOKEN_STAR:
+                return number_object_construct(a * b);
+        default:
+                return NULL;
+        }
+}
+
+static AstRef fold_binary_expr(AstRef ref) {
+        BinaryExpr *binary_expr = ast_node(ref);
+        binary_expr->left = fold_expr(binary_expr->left);
+        binary_expr->right = fold_expr(binary_expr->right);
+        if (!is_literal(binary_expr->left) || !is_literal(binary_expr->right)) {
+                return ref;
+        }
+        Object *value = fold_binary_operator(binary_expr->base.operator, literal_value(binary_expr->left),
+                                             literal_value(binary_expr->right));
+        return value == NULL ? ref : literal(value);
+}
+
+static AstRef fold_call_expr(AstRef ref) {
+        CallExpr *call_expr = ast_node(ref);
+        call_expr->callee = fold_expr(call_expr->callee);
+        AstRef *arguments = ast_node(call_expr->arguments.start);
+        for (size_t i = 0; i < call_expr->arguments.size; i++) {
+                arguments[i] = fold_expr(arguments[i]);
+        }
+        return ref;
+}
+
+static AstRef fold_get_expr(AstRef ref) {
+        GetExpr *get_expr = ast_node(ref);
+        get_expr->object = fold_expr(get_expr->object);
+        return ref;
+}
+
+static AstRef fold_grouping_expr(AstRef ref) {
+        const GroupingExpr *grouping_expr = ast_node(ref);
+        return fold_expr(grouping_expr->expression);
+}
+
+static AstRef fold_logical_expr(AstRef ref) {
+        LogicalExpr *logical_expr = ast_node(ref);
+        logical_expr->left = fold_expr(logical_expr->left);
+        logical_expr->right = fold_expr(logical_expr->right);
+        if (!is_literal(logical_expr->left)) {
+                return ref;
+        }
+        bool is_truthy = object_is_truthy(literal_value(logical_expr->left));
+        if (logical_expr->base.operator == TOKEN_OR) {
+                return is_truthy ? logical_expr->left : logical_expr->right;
+        }
+        return is_truthy ? logical_expr->right : logical_expr->left;
+}
+
+static AstRef fold_set_expr(AstRef ref) {
+        SetExpr *set_expr = ast_node(ref);
+        set_expr->object = fold_expr(set_expr->object);
+        set_expr->value = fold_expr(set_expr->value);
+        return ref;
+}
+
+static AstRef fold_unary_expr(AstRef ref) {
+        UnaryExpr *unary_expr = ast_node(ref);
+        unary_expr->right = fold_expr(unary_expr->right);
+        if (!is_literal(unary_expr->right)) {
+                return ref;
+        }
+        const Object *right = literal_value(unary_expr->right);
+        if (unary_expr->base.operator == TOKEN_BANG) {
+                return literal(boolean_object_construct(!object_is_truthy(right)));
+        }
+        if (!object_is_number(right)) {
+                return ref;
+        }
+        return literal(number_object_construct(-object_as_number(right)));
+}
+
+static AstRef fold_expr(AstRef ref) {
+        const Expr *expr = ast_node(ref);
+        switch (expr->type) {
+        case EXPR_ASSIGN:
+                return fold_assign_expr(ref);
+        case EXPR_BINARY:
+                return fold_binary_expr(ref);
+        case EXPR_CALL:
+                return fold_call_expr(ref);
+        case EXPR_GET:
+                return fold_get_expr(ref);
+        case EXPR_GROUPING:
+                return fold_grouping_expr(ref);
+        case EXPR_LOGICAL:
+                return fold_logical_expr(ref);
+        case EXPR_SET:
+                return fold_set_expr(ref);
+        case EXPR_UNARY:
+                return fold_unary_expr(ref);
+        default:
+                return ref;
+        }
+}
+
+static AstRef fold_branch(AstRef ref) {
+        AstRef folded = fold_stmt(ref);
+        return folded == AST_NULL ? empty_block() : folded;
+}
+
+static AstRef fold_block_stmt(AstRef ref) {
+        BlockStmt *block_stmt = ast_node(ref);
+        block_stmt->statements = fold_stmt_list(block_stmt->statements);
+        return block_stmt->statements.size == 0 ? AST_NULL : ref;
+}
+
+static AstRef fold_function_stmt(AstRef ref) {
+        FunctionStmt *function_stmt = ast_node(ref);
+        function_stmt->body = fold_stmt_list(function_stmt->body);
+        return ref;
+}
+
+static AstRef fold_class_stmt(AstRef ref) {
+        const ClassStmt *class_stmt = ast_node(ref);
+        const AstRef *methods = ast_refs(class_stmt->methods);
+        for (size_t i = 0; i < class_stmt->methods.size; i++) {
+                fold_function_stmt(methods[i]);
+        }
+        return ref;
+}
+
+static AstRef fold_expression_stmt(AstRef ref) {
+        ExpressionStmt *expression_stmt = ast_node(ref);
+        expression_stmt->expression = fold_expr(expression_stmt->expression);
+        return is_literal(expression_stmt->expression) ? AST_NULL : ref;
+}
+
+static AstRef fold_if_stmt(AstRef ref) {
+        IfStmt *if_stmt = ast_node(ref);
+        if_stmt->condition = fold_expr(if_stmt->condition);
+        AstRef then_branch = fold_stmt(if_stmt->then_branch);
+        AstRef else_branch = if_stmt->else_branch == AST_NULL ? AST_NULL : fold_stmt(if_stmt->else_branch);
+        if (is_literal(if_stmt->condition)) {
+                return object_is_truthy(literal_value(if_stmt->condition)) ? then_branch : else_branch;
+        }
+        if_stmt->then_branch = then_branch == AST_NULL ? empty_block() : then_branch;
+        if_stmt->else_branch = else_branch;
+        return ref;
+}
+
+static AstRef fold_print_stmt(AstRef ref) {
+        PrintStmt *print_stmt = ast_node(ref);
+        print_stmt->expression = fold_expr(print_stmt->expression);
+        return ref;
+}
+
+static AstRef fold_return_stmt(AstRef ref) {
+        ReturnStmt *return_stmt = ast_node(ref);
+        if (return_stmt->value != AST_NULL) {
+                return_stmt->value = fold_expr(return_stmt->value);
+        }
+        return ref;
+}
+
+static AstRef fold_var_stmt(AstRef ref) {
+        VarStmt *var_stmt = ast_node(ref);
+        if (var_stmt->initializer != AST_NULL) {
+                var_stmt->initializer = fold_expr(var_stmt->initializer);
+        }
+        return ref;
+}
+
+static AstRef fold_while_stmt(AstRef ref) {
+        WhileStmt *while_stmt = ast_node(ref);
+        while_stmt->condition = fold_expr(while_stmt->condition);
+        if (is_literal(while_stmt->condition) && !object_is_truthy(literal_value(while_stmt->condition))) {
+                return AST_NULL;
+        }
+        while_stmt->body = fold_branch(while_stmt->body);
+        return ref;
+}
+
+static AstRef fold_stmt(AstRef ref) {
+        const Stmt *stmt = ast_node(ref);
+        switch (stmt->type) {
+        case STMT_BLOCK:
+                return fold_block_stmt(ref);
+        case STMT_CLASS:
+                return fold_class_stmt(ref);
+        case STMT_EXPRESSION:
+                return fold_expression_stmt(ref);
+        case STMT_FUNCTION:
+                return fold_function_stmt(ref);
+        case STMT_IF:
+                return fold_if_stmt(ref);
+        case STMT_PRINT:
+                return fold_print_stmt(ref);
+        case STMT_RETURN:
+                return fold_return_stmt(ref);
+        case STMT_VAR:
+                return fold_var_stmt(ref);
+        case STMT_WHILE:
+                return fold_while_stmt(ref);
+        }
+        return ref;
+}
+
+static AstList fold_stmt_list(AstList statements) {
+        AstRef *refs = ast_node(statements.start);
+        uint32_t size = 0;
+        for (size_t i = 0; i < statements.size; i++) {
+                AstRef folded = fold_stmt(refs[i]);
+                if (folded != AST_NULL) {
+                        refs[size++] = folded;
+                }
+        }
+        statements.size = size;
+        return statements;
+}
+
+AstList optimize_stmts(AstList statements) {
+        return fold_stmt_list(statements);
+}
@@ -0,0 +1,8 @@
+#ifndef CODECRAFTERS_INTERPRETER_LOX_OPTIMIZER_H
+#define CODECRAFTERS_INTERPRETER_LOX_OPTIMIZER_H
+
+#include "lox/ast.h"
+
+AstList optimize_stmts(AstList statements);
+
+#endif
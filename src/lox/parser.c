@@ -1,25 +1,35 @@
 #include "lox/parser.h"
+#include "lox/ast.h"
 #include "lox/errors.h"
 #include "lox/expr.h"
+#include "lox/scanner.h"
 #include "lox/stmt.h"
 #include "lox/token.h"
 #include "lox/object.h"
-#include "util/vector.h"
+#include "util/intern.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+
+#define RING_SIZE 2
 
 static struct {
-        const Vector *tokens;
+        Token ring[RING_SIZE];
         size_t current;
 } parser;
 
-static void init(const Vector *tokens) {
-        parser.tokens = tokens;
+static void fill(size_t index) {
+        scanner_next(&parser.ring[index % RING_SIZE]);
+}
+
+static void init(const char *source) {
+        scanner_init(source);
         parser.current = 0;
+        fill(parser.current);
 }
 
 static Token *peek(void) {
-        return vector_at(parser.tokens, parser.current);
+        return &parser.ring[parser.current % RING_SIZE];
 }
 
 static bool check(TokenType type) {
@@ -31,16 +41,36 @@ static bool is_at_end(void) {
 }
 
 static Token *previous(void) {
-        return vector_at(parser.tokens, parser.current - 1);
+        return &parser.ring[(parser.current - 1) % RING_SIZE];
 }
 
-static Token *advance(void) {
+static const char *previous_name(void) {
+        return intern(previous()->lexeme, previous()->length);
+}
+
+static void advance(void) {
         if (!is_at_end()) {
                 parser.current++;
+                fill(parser.current);
+        }
+}
+
+static void finish_scanning(void) {
+        while (!is_at_end()) {
+                advance();
         }
-        return previous();
 }
 
+#define error(token, ...) \
+        do { \
+                Token error_token = *(token); \
+                finish_scanning(); \
+                if (has_scan_error()) { \
+                        exit(65); \
+                } \
+                parse_error(&error_token, __VA_ARGS__); \
+        } while (false)
+
 static bool match(TokenType type) {
         if (!check(type)) {
                 return false;
@@ -73,7 +103,7 @@ static Stmt *print_statement(void);
 static Stmt *return_statement(void);
 static Stmt *while_statement(void);
 static Stmt *expression_statement(void);
-static Vector *block(void);
+static AstList block(void);
 
 static Expr *expression(void) {
         return assignment();
@@ -82,18 +112,19 @@ static Expr *expression(void) {
 static Expr *assignment(void) {
         Expr *expr = or();
         if (match(TOKEN_EQUAL)) {
-                Token *equals = previous();
+                Token equals = *previous();
                 Expr *value = assignment();
 
                 if (expr->type == EXPR_VARIABLE) {
-                        Token *name = ((VariableExpr *)expr)->name;
-                        return (Expr *)assign_expr_construct(name, value);
+                        VariableExpr *variable_expr = (VariableExpr *)expr;
+                        return (Expr *)assign_expr_construct(variable_expr->name, variable_expr->base.line, value);
                 } else if (expr->type == EXPR_GET) {
                         GetExpr *get_expr = (GetExpr *)expr;
-                        return (Expr *)set_expr_construct(get_expr->object, get_expr->name, value);
+                        Expr *object = ast_node(get_expr->object);
+                        return (Expr *)set_expr_construct(object, get_expr->name, get_expr->base.line, value);
                 }
 
-                parse_error(equals, "Invalid assignment target.");
+                error(&equals, "Invalid assignment target.");
         }
         return expr;
 }
@@ -101,9 +132,9 @@ static Expr *assignment(void) {
 static Expr *or(void) {
         Expr *expr = and();
         while (match(TOKEN_OR)) {
-                Token *operator = previous();
+                Token operator = *previous();
                 Expr *right = and();
-                expr = (Expr *)logical_expr_construct(expr, operator, right);
+                expr = (Expr *)logical_expr_construct(expr, &operator, right);
         }
         return expr;
 }
@@ -111,9 +142,9 @@ static Expr *or(void) {
 static Expr *and(void) {
         Expr *expr = equality();
         while (match(TOKEN_AND)) {
-                Token *operator = previous();
+                Token operator = *previous();
                 Expr *right = equality();
-                expr = (Expr *)logical_expr_construct(expr, operator, right);
+                expr = (Expr *)logical_expr_construct(expr, &operator, right);
         }
         return expr;
 }
@@ -121,9 +152,9 @@ static Expr *and(void) {
 static Expr *equality(void) {
         Expr *expr = comparison();
         while (match(TOKEN_BANG_EQUAL) || match(TOKEN_EQUAL_EQUAL)) {
-                Token *operator = previous();
+                Token operator = *previous();
                 Expr *right = comparison();
-                expr = (Expr *)binary_expr_construct(expr, operator, right);
+                expr = (Expr *)binary_expr_construct(expr, &operator, right);
         }
         return expr;
 }
@@ -131,9 +162,9 @@ static Expr *equality(void) {
 static Expr *comparison(void) {
         Expr *expr = term();
         while (match(TOKEN_GREATER) || match(TOKEN_GREATER_EQUAL) || match(TOKEN_LESS) || match(TOKEN_LESS_EQUAL)) {
-                Token *operator = previous();
+                Token operator = *previous();
                 Expr *right = term();
-                expr = (Expr *)binary_expr_construct(expr, operator, right);
+                expr = (Expr *)binary_expr_construct(expr, &operator, right);
         }
         return expr;
 }
@@ -141,9 +172,9 @@ static Expr *comparison(void) {
 static Expr *term(void) {
         Expr *expr = factor();
         while (match(TOKEN_MINUS) || match(TOKEN_PLUS)) {
-                Token *operator = previous();
+                Token operator = *previous();
                 Expr *right = factor();
-                expr = (Expr *)binary_expr_construct(expr, operator, right);
+                expr = (Expr *)binary_expr_construct(expr, &operator, right);
         }
         return expr;
 }
@@ -151,18 +182,18 @@ static Expr *term(void) {
 static Expr *factor(void) {
         Expr *expr = unary();
         while (match(TOKEN_SLASH) || match(TOKEN_STAR)) {
-                Token *operator = previous();
+                Token operator = *previous();
                 Expr *right = unary();
-                expr = (Expr *)binary_expr_construct(expr, operator, right);
+                expr = (Expr *)binary_expr_construct(expr, &operator, right);
         }
         return expr;
 }
 
 static Expr *unary(void) {
         if (match(TOKEN_BANG) || match(TOKEN_MINUS)) {
-                Token *operator = previous();
+                Token operator = *previous();
                 Expr *right = unary();
-                return (Expr *)unary_expr_construct(operator, right);
+                return (Expr *)unary_expr_construct(&operator, right);
         }
         return call();
 }
@@ -174,9 +205,9 @@ static Expr *call(void) {
                         expr = finish_call(expr);
                 } else if (match(TOKEN_DOT)) {
                         if (!match(TOKEN_IDENTIFIER)) {
-                                parse_error(peek(), "Expect property name after '.'.");
+                                error(peek(), "Expect property name after '.'.");
                         }
-                        expr = (Expr *)get_expr_construct(expr, previous());
+                        expr = (Expr *)get_expr_construct(expr, previous_name(), previous()->line);
                 } else {
                         break;
                 }
@@ -185,22 +216,23 @@ static Expr *call(void) {
 }
 
 static Expr *finish_call(Expr *callee) {
-        Vector *arguments = vector_construct();
+        size_t mark = ast_list_begin();
+        size_t num_arguments = 0;
         if (!check(TOKEN_RIGHT_PAREN)) {
                 do {
-                        if (vector_size(arguments) >= 255) {
-                                parse_error(peek(), "Can't have more than 255 arguments.");
+                        if (num_arguments >= 255) {
+                                error(peek(), "Can't have more than 255 arguments.");
                         }
-                        vector_push_back(arguments, expression());
+                        ast_list_push(ast_ref(expression()));
+                        num_arguments++;
                 } while (match(TOKEN_COMMA));
         }
 
         if (!match(TOKEN_RIGHT_PAREN)) {
-                parse_error(peek(), "Expect ')' after arguments.");
+                error(peek(), "Expect ')' after arguments.");
         }
-        Token *paren = previous();
 
-        return (Expr *)call_expr_construct(callee, paren, arguments);
+        return (Expr *)call_expr_construct(callee, previous()->line, ast_list_end(mark));
 }
 
 static Expr *primary(void) {
@@ -215,37 +247,37 @@ static Expr *primary(void) {
         }
 
         if (match(TOKEN_NUMBER) || match(TOKEN_STRING)) {
-                return (Expr *)literal_expr_construct(previous()->literal);
+                return (Expr *)literal_expr_construct(token_literal(previous()));
         }
 
         if (match(TOKEN_SUPER)) {
-                Token *keyword = previous();
+                size_t line = previous()->line;
                 if (!match(TOKEN_DOT)) {
-                        parse_error(peek(), "Expect '.' after 'super'.");
+                        error(peek(), "Expect '.' after 'super'.");
                 }
                 if (!match(TOKEN_IDENTIFIER)) {
-                        parse_error(peek(), "Expect superclass method name.");
+                        error(peek(), "Expect superclass method name.");
                 }
-                return (Expr *)super_expr_construct(keyword, previous());
+                return (Expr *)super_expr_construct(line, previous_name(), previous()->line);
         }
 
         if (match(TOKEN_THIS)) {
-                return (Expr *)this_expr_construct(previous());
+                return (Expr *)this_expr_construct(previous()->line);
         }
 
         if (match(TOKEN_IDENTIFIER)) {
-                return (Expr *)variable_expr_construct(previous());
+                return (Expr *)variable_expr_construct(previous_name(), previous()->line);
         }
 
         if (match(TOKEN_LEFT_PAREN)) {
                 Expr *expr = expression();
                 if (!match(TOKEN_RIGHT_PAREN)) {
-                        parse_error(peek(), "Expect ')' after expression.");
+                        error(peek(), "Expect ')' after expression.");
                 }
                 return (Expr *)grouping_expr_construct(expr);
         }
 
-        parse_error(peek(), "Expect expression.");
+        error(peek(), "Expect expression.");
 }
 
 static Stmt *declaration(void) {
@@ -263,71 +295,78 @@ static Stmt *declaration(void) {
 
 static Stmt *class_declaration(void) {
         if (!match(TOKEN_IDENTIFIER)) {
-                parse_error(peek(), "Expect class name.");
+                error(peek(), "Expect class name.");
         }
-        Token *name = previous();
+        const char *name = previous_name();
+        size_t line = previous()->line;
 
         VariableExpr *superclass = NULL;
         if (match(TOKEN_LESS)) {
                 if (!match(TOKEN_IDENTIFIER)) {
-                        parse_error(peek(), "Expect superclass name.");
+                        error(peek(), "Expect superclass name.");
                 }
-                superclass = variable_expr_construct(previous());
+                superclass = variable_expr_construct(previous_name(), previous()->line);
         }
 
         if (!match(TOKEN_LEFT_BRACE)) {
-                parse_error(peek(), "Expect '{' before class body.");
+                error(peek(), "Expect '{' before class body.");
         }
 
-        Vector *methods = vector_construct();
+        size_t mark = ast_list_begin();
         while (!check(TOKEN_RIGHT_BRACE) && !is_at_end()) {
-                vector_push_back(methods, function("method"));
+                ast_list_push(ast_ref(function("method")));
         }
+        AstList methods = ast_list_end(mark);
 
         if (!match(TOKEN_RIGHT_BRACE)) {
-                parse_error(peek(), "Expect '}' after class body.");
+                error(peek(), "Expect '}' after class body.");
         }
 
-        return (Stmt *)class_stmt_construct(name, superclass, methods);
+        return (Stmt *)class_stmt_construct(name, line, superclass, methods);
 }
 
 static FunctionStmt *function(const char *kind) {
         if (!match(TOKEN_IDENTIFIER)) {
-                parse_error(peek(), "Expect %s name.", kind);
+                error(peek(), "Expect %s name.", kind);
         }
-        Token *name = previous();
+        const char *name = previous_name();
+        size_t line = previous()->line;
         if (!match(TOKEN_LEFT_PAREN)) {
-                parse_error(peek(), "Expect '(' after %s name.", kind);
+                error(peek(), "Expect '(' after %s name.", kind);
         }
 
-        Vector *params = vector_construct();
+        size_t mark = ast_list_begin();
+        size_t num_params = 0;
         if (!check(TOKEN_RIGHT_PAREN)) {
                 do {
-                        if (vector_size(params) >= 255) {
-                                parse_error(peek(), "Can't have more than 255 parameters.");
+                        if (num_params >= 255) {
+                                error(peek(), "Can't have more than 255 parameters.");
                         }
                         if (!match(TOKEN_IDENTIFIER)) {
-                                parse_error(peek(), "Expect parameter name.");
+                                error(peek(), "Expect parameter name.");
                         }
-                        vector_push_back(params, previous());
+                        ast_list_push(ast_ref(variable_expr_construct(previous_name(), previous()->line)));
+                        num_params++;
                 } while (match(TOKEN_COMMA));
         }
         if (!match(TOKEN_RIGHT_PAREN)) {
-                parse_error(peek(), "Expect ')' after parameters.");
+                error(peek(), "Expect ')' after parameters.");
         }
+        AstList params = ast_list_end(mark);
 
         if (!match(TOKEN_LEFT_BRACE)) {
-                parse_error(peek(), "Expect '{' before %s body.", kind);
+                error(peek(), "Expect '{' before %s body.", kind);
         }
-        Vector *body = block();
-        return function_stmt_construct(name, params, body);
+        AstList body = block();
+        return function_stmt_construct(name, line, params, body);
 }
 
 static Stmt *var_declaration(void) {
         if (!match(TOKEN_IDENTIFIER)) {
-                parse_error(peek(), "Expect variable name.");
+                error(peek(), "Expect variable name.");
         }
-        Token *name = previous();
+        const char *name = previous_name();
+        size_t line = previous()->line;
 
         Expr *initializer = NULL;
         if (match(TOKEN_EQUAL)) {
@@ -335,10 +374,10 @@ static Stmt *var_declaration(void) {
         }
 
         if (!match(TOKEN_SEMICOLON)) {
-                parse_error(peek(), "Expect ';' after variable declaration.");
+                error(peek(), "Expect ';' after variable declaration.");
         }
 
-        return (Stmt *)var_stmt_construct(name, initializer);
+        return (Stmt *)var_stmt_construct(name, line, initializer);
 }
 
 static Stmt *statement(void) {
@@ -365,7 +404,7 @@ static Stmt *statement(void) {
 
 static Stmt *for_statement(void) {
         if (!match(TOKEN_LEFT_PAREN)) {
-                parse_error(peek(), "Expect '(' after 'for'.");
+                error(peek(), "Expect '(' after 'for'.");
         }
 
         Stmt *initializer;
@@ -382,7 +421,7 @@ static Stmt *for_statement(void) {
                 condition = expression();
         }
         if (!match(TOKEN_SEMICOLON)) {
-                parse_error(peek(), "Expect ';' after loop condition.");
+                error(peek(), "Expect ';' after loop condition.");
         }
 
         Expr *increment = NULL;
@@ -390,16 +429,16 @@ static Stmt *for_statement(void) {
                 increment = expression();
         }
         if (!match(TOKEN_RIGHT_PAREN)) {
-                parse_error(peek(), "Expect ')' after for clauses.");
+                error(peek(), "Expect ')' after for clauses.");
         }
 
         Stmt *body = statement();
 
         if (increment != NULL) {
-                Vector *statements = vector_construct();
-                vector_push_back(statements, body);
-                vector_push_back(statements, expression_stmt_construct(increment));
-                body = (Stmt *)block_stmt_construct(statements);
+                size_t mark = ast_list_begin();
+                ast_list_push(ast_ref(body));
+                ast_list_push(ast_ref(expression_stmt_construct(increment)));
+                body = (Stmt *)block_stmt_construct(ast_list_end(mark));
         }
 
         if (condition == NULL) {
@@ -408,10 +447,10 @@ static Stmt *for_statement(void) {
         body = (Stmt *)while_stmt_construct(condition, body);
 
         if (initializer != NULL) {
-                Vector *statements = vector_construct();
-                vector_push_back(statements, initializer);
-                vector_push_back(statements, body);
-                body = (Stmt *)block_stmt_construct(statements);
+                size_t mark = ast_list_begin();
+                ast_list_push(ast_ref(initializer));
+                ast_list_push(ast_ref(body));
+                body = (Stmt *)block_stmt_construct(ast_list_end(mark));
         }
 
         return body;
@@ -419,11 +458,11 @@ static Stmt *for_statement(void) {
 
 static Stmt *if_statement(void) {
         if (!match(TOKEN_LEFT_PAREN)) {
-                parse_error(peek(), "Expect '(' after 'if'.");
+                error(peek(), "Expect '(' after 'if'.");
         }
         Expr *condition = expression();
         if (!match(TOKEN_RIGHT_PAREN)) {
-                parse_error(peek(), "Expect ')' after if condition.");
+                error(peek(), "Expect ')' after if condition.");
         }
 
         Stmt *then_branch = statement();
@@ -438,32 +477,32 @@ static Stmt *if_statement(void) {
 static Stmt *print_statement(void) {
         Expr *expr = expression();
         if (!match(TOKEN_SEMICOLON)) {
-                parse_error(peek(), "Expect ';' after value.");
+                error(peek(), "Expect ';' after value.");
         }
         return (Stmt *)print_stmt_construct(expr);
 }
 
 static Stmt *return_statement(void) {
-        Token *keyword = previous();
+        size_t line = previous()->line;
 
         Expr *value = NULL;
         if (!check(TOKEN_SEMICOLON)) {
                 value = expression();
         }
         if (!match(TOKEN_SEMICOLON)) {
-                parse_error(peek(), "Expect ';' after return value.");
+                error(peek(), "Expect ';' after return value.");
         }
 
-        return (Stmt *)return_stmt_construct(keyword, value);
+        return (Stmt *)return_stmt_construct(line, value);
 }
 
 static Stmt *while_statement(void) {
         if (!match(TOKEN_LEFT_PAREN)) {
-                parse_error(peek(), "Expect '(' after 'while'.");
+                error(peek(), "Expect '(' after 'while'.");
         }
         Expr *condition = expression();
         if (!match(TOKEN_RIGHT_PAREN)) {
-                parse_error(peek(), "Expect ')' after condition.");
+                error(peek(), "Expect ')' after condition.");
         }
         Stmt *body = statement();
         return (Stmt *)while_stmt_construct(condition, body);
@@ -472,32 +511,34 @@ static Stmt *while_statement(void) {
 static Stmt *expression_statement(void) {
         Expr *expr = expression();
         if (!match(TOKEN_SEMICOLON)) {
-                parse_error(peek(), "Expect ';' after expression.");
+                error(peek(), "Expect ';' after expression.");
         }
         return (Stmt *)expression_stmt_construct(expr);
 }
 
-static Vector *block(void) {
-        Vector *statements = vector_construct();
+static AstList block(void) {
+        size_t mark = ast_list_begin();
         while (!check(TOKEN_RIGHT_BRACE) && !is_at_end()) {
-                vector_push_back(statements, declaration());
+                ast_list_push(ast_ref(declaration()));
         }
         if (!match(TOKEN_RIGHT_BRACE)) {
-                parse_error(peek(), "Expect '}' after block.");
+                error(peek(), "Expect '}' after block.");
         }
-        return statements;
+        return ast_list_end(mark);
 }
 
-Expr *parse_expr(const Vector *tokens) {
-        init(tokens);
-        return expression();
+Expr *parse_expr(const char *source) {
+        init(source);
+        Expr *expr = expression();
+        finish_scanning();
+        return expr;
 }
 
-Vector *parse_stmts(const Vector *tokens) {
-        init(tokens);
-        Vector *statements = vector_construct();
+AstList parse_stmts(const char *source) {
+        init(source);
+        size_t mark = ast_list_begin();
         while (!is_at_end()) {
-                vector_push_back(statements, declaration());
+                ast_list_push(ast_ref(declaration()));
         }
-        return statements;
+        return ast_list_end(mark);
 }
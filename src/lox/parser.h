@@ -1,10 +1,10 @@
 #ifndef CODECRAFTERS_INTERPRETER_LOX_PARSER_H
 #define CODECRAFTERS_INTERPRETER_LOX_PARSER_H
 
+#include "lox/ast.h"
 #include "lox/expr.h"
-#include "util/vector.h"
 
-Expr *parse_expr(const Vector *tokens);
-Vector *parse_stmts(const Vector *tokens);
+Expr *parse_expr(const char *source);
+AstList parse_stmts(const char *source);
 
 #endif
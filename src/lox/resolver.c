@@ -1,11 +1,12 @@
 #include "lox/resolver.h"
+#include "lox/ast.h"
 #include "lox/errors.h"
 #include "lox/expr.h"
-#include "lox/interpreter.h"
 #include "lox/stmt.h"
-#include "lox/token.h"
+#include "util/intern.h"
 #include "util/map.h"
 #include "util/vector.h"
+#include "util/xmalloc.h"
 
 #include <stdbool.h>
 #include <string.h>
@@ -23,6 +24,16 @@ typedef enum {
         FUNCTION_METHOD,
 } FunctionType;
 
+typedef struct {
+        size_t slot;
+        bool is_defined;
+} Binding;
+
+typedef struct {
+        Map *bindings;
+        size_t num_slots;
+} Scope;
+
 static struct {
         Vector *scopes;
         ClassType current_class;
@@ -41,305 +52,327 @@ static void init(void) {
 }
 
 static void begin_scope(void) {
-        vector_push_back(resolver.scopes, map_construct(str_compare));
+        Scope *scope = xmalloc(sizeof(Scope));
+        scope->bindings = map_construct(ptr_hash, ptr_compare);
+        scope->num_slots = 0;
+        vector_push_back(resolver.scopes, scope);
 }
 
-static void end_scope(void) {
+static size_t end_scope(void) {
+        Scope *scope = vector_at_back(resolver.scopes);
         vector_pop_back(resolver.scopes);
+        return scope->num_slots;
+}
+
+static size_t add_binding(Scope *scope, const char *name, bool is_defined) {
+        Binding *binding = xmalloc(sizeof(Binding));
+        binding->slot = scope->num_slots++;
+        binding->is_defined = is_defined;
+        map_put(scope->bindings, name, binding);
+        return binding->slot;
 }
 
-static void declare(const Token *name) {
+static size_t declare(const char *name, size_t line) {
         if (vector_is_empty(resolver.scopes)) {
-                return;
+                return 0;
         }
-        Map *scope = vector_at_back(resolver.scopes);
+        Scope *scope = vector_at_back(resolver.scopes);
 
-        if (map_contains(scope, name->lexeme)) {
-                resolve_error(name, "Already a variable with this name in this scope.");
+        if (map_contains(scope->bindings, name)) {
+                resolve_error(line, name, "Already a variable with this name in this scope.");
         }
-        map_put(scope, name->lexeme, (void *)false);
+        return add_binding(scope, name, false);
 }
 
-static void define(const Token *name) {
+static void define(const char *name) {
         if (vector_is_empty(resolver.scopes)) {
                 return;
         }
-        Map *scope = vector_at_back(resolver.scopes);
-        map_put(scope, name->lexeme, (void *)true);
+        Scope *scope = vector_at_back(resolver.scopes);
+        Binding *binding = map_get(scope->bindings, name);
+        binding->is_defined = true;
 }
 
-static void resolve_local(const Expr *expr, const Token *name) {
+static void resolve_local(VariableLocation *location, const char *name) {
         size_t num_scopes = vector_size(resolver.scopes);
         for (size_t i = 0; i < num_scopes; i++) {
-                Map *scope = vector_at(resolver.scopes, num_scopes - i - 1);
-                if (map_contains(scope, name->lexeme)) {
-                        interpreter_resolve(expr, i);
+                Scope *scope = vector_at(resolver.scopes, num_scopes - i - 1);
+                void *binding;
+                if (map_find(scope->bindings, name, &binding)) {
+                        location->is_local = true;
+                        location->depth = i;
+                        location->slot = ((Binding *)binding)->slot;
                         return;
                 }
         }
 }
 
-static void resolve_function(const FunctionStmt *function, FunctionType type) {
+static void resolve_stmt_list(AstList statements);
+
+static void resolve_function(FunctionStmt *function, FunctionType type) {
         FunctionType enclosing_function = resolver.current_function;
         resolver.current_function = type;
 
         begin_scope();
-        size_t num_params = vector_size(function->params);
-        for (size_t i = 0; i < num_params; i++) {
-                Token *param = vector_at(function->params, i);
-                declare(param);
-                define(param);
+        const AstRef *params = ast_refs(function->params);
+        for (size_t i = 0; i < function->params.size; i++) {
+                const VariableExpr *param = ast_node(params[i]);
+                declare(param->name, param->base.line);
+                define(param->name);
+        }
+        if (type == FUNCTION_INITIALIZER || type == FUNCTION_METHOD) {
+                add_binding(vector_at_back(resolver.scopes), intern_string("this"), true);
         }
-        resolve_stmts(function->body);
-        end_scope();
+        resolve_stmt_list(function->body);
+        function->num_slots = end_scope();
 
         resolver.current_function = enclosing_function;
 }
 
-static void resolve_expr(const Expr *expr);
+static void resolve_expr(Expr *expr);
 
-static void resolve_assign_expr(const AssignExpr *assign_expr) {
-        resolve_expr(assign_expr->value);
-        resolve_local((const Expr *)assign_expr, assign_expr->name);
+static void resolve_assign_expr(AssignExpr *assign_expr) {
+        resolve_expr(ast_node(assign_expr->value));
+        resolve_local(&assign_expr->location, assign_expr->name);
 }
 
-static void resolve_binary_expr(const BinaryExpr *binary_expr) {
-        resolve_expr(binary_expr->left);
-        resolve_expr(binary_expr->right);
+static void resolve_binary_expr(BinaryExpr *binary_expr) {
+        resolve_expr(ast_node(binary_expr->left));
+        resolve_expr(ast_node(binary_expr->right));
 }
 
-static void resolve_call_expr(const CallExpr *call_expr) {
-        resolve_expr(call_expr->callee);
-        size_t num_arguments = vector_size(call_expr->arguments);
-        for (size_t i = 0; i < num_arguments; i++) {
-                resolve_expr(vector_at(call_expr->arguments, i));
+static void resolve_call_expr(CallExpr *call_expr) {
+        resolve_expr(ast_node(call_expr->callee));
+        const AstRef *arguments = ast_refs(call_expr->arguments);
+        for (size_t i = 0; i < call_expr->arguments.size; i++) {
+                resolve_expr(ast_node(arguments[i]));
         }
 }
 
-static void resolve_get_expr(const GetExpr *get_expr) {
-        resolve_expr(get_expr->object);
+static void resolve_get_expr(GetExpr *get_expr) {
+        resolve_expr(ast_node(get_expr->object));
 }
 
-static void resolve_grouping_expr(const GroupingExpr *grouping_expr) {
-        resolve_expr(grouping_expr->expression);
+static void resolve_grouping_expr(GroupingExpr *grouping_expr) {
+        resolve_expr(ast_node(grouping_expr->expression));
 }
 
-static void resolve_literal_expr(const LiteralExpr *literal_expr) {
+static void resolve_literal_expr(LiteralExpr *literal_expr) {
         return;
 }
 
-static void resolve_logical_expr(const LogicalExpr *logical_expr) {
-        resolve_expr(logical_expr->left);
-        resolve_expr(logical_expr->right);
+static void resolve_logical_expr(LogicalExpr *logical_expr) {
+        resolve_expr(ast_node(logical_expr->left));
+        resolve_expr(ast_node(logical_expr->right));
 }
 
-static void resolve_set_expr(const SetExpr *set_expr) {
-        resolve_expr(set_expr->value);
-        resolve_expr(set_expr->object);
+static void resolve_set_expr(SetExpr *set_expr) {
+        resolve_expr(ast_node(set_expr->value));
+        resolve_expr(ast_node(set_expr->object));
 }
 
-static void resolve_super_expr(const SuperExpr *super_expr) {
+static void resolve_super_expr(SuperExpr *super_expr) {
         if (resolver.current_class == CLASS_NONE) {
-                resolve_error(super_expr->keyword, "Can't use 'super' outside of a class.");
+                resolve_error(super_expr->base.line, "super", "Can't use 'super' outside of a class.");
         } else if (resolver.current_class != CLASS_SUBCLASS) {
-                resolve_error(super_expr->keyword, "Can't use 'super' in a class with no superclass.");
+                resolve_error(super_expr->base.line, "super", "Can't use 'super' in a class with no superclass.");
         }
-        resolve_local((const Expr *)super_expr, super_expr->keyword);
+        resolve_local(&super_expr->location, intern_string("super"));
+        resolve_local(&super_expr->this_location, intern_string("this"));
 }
 
-static void resolve_this_expr(const ThisExpr *this_expr) {
+static void resolve_this_expr(ThisExpr *this_expr) {
         if (resolver.current_class == CLASS_NONE) {
-                resolve_error(this_expr->keyword, "Can't use 'this' outside of a class.");
+                resolve_error(this_expr->base.line, "this", "Can't use 'this' outside of a class.");
         }
-        resolve_local((const Expr *)this_expr, this_expr->keyword);
+        resolve_local(&this_expr->location, intern_string("this"));
 }
 
-static void resolve_unary_expr(const UnaryExpr *unary_expr) {
-        resolve_expr(unary_expr->right);
+static void resolve_unary_expr(UnaryExpr *unary_expr) {
+        resolve_expr(ast_node(unary_expr->right));
 }
 
-static void resolve_variable_expr(const VariableExpr *variable_expr) {
+static void resolve_variable_expr(VariableExpr *variable_expr) {
         if (!vector_is_empty(resolver.scopes)) {
-                Map *scope = vector_at_back(resolver.scopes);
-                const Token *name = variable_expr->name;
-                if (map_contains(scope, name->lexeme) && !(bool)map_get(scope, name->lexeme)) {
-                        resolve_error(name, "Can't read local variable in its own initializer.");
+                Scope *scope = vector_at_back(resolver.scopes);
+                const char *name = variable_expr->name;
+                void *binding;
+                if (map_find(scope->bindings, name, &binding) && !((Binding *)binding)->is_defined) {
+                        resolve_error(variable_expr->base.line, name, "Can't read local variable in its own initializer.");
                 }
         }
-        resolve_local((const Expr *)variable_expr, variable_expr->name);
+        resolve_local(&variable_expr->location, variable_expr->name);
 }
 
-static void resolve_expr(const Expr *expr) {
+static void resolve_expr(Expr *expr) {
         switch (expr->type) {
         case EXPR_ASSIGN:
-                resolve_assign_expr((const AssignExpr *)expr);
+                resolve_assign_expr((AssignExpr *)expr);
                 break;
         case EXPR_BINARY:
-                resolve_binary_expr((const BinaryExpr *)expr);
+                resolve_binary_expr((BinaryExpr *)expr);
                 break;
         case EXPR_CALL:
-                resolve_call_expr((const CallExpr *)expr);
+                resolve_call_expr((CallExpr *)expr);
                 break;
         case EXPR_GET:
-                resolve_get_expr((const GetExpr *)expr);
+                resolve_get_expr((GetExpr *)expr);
                 break;
         case EXPR_GROUPING:
-                resolve_grouping_expr((const GroupingExpr *)expr);
+                resolve_grouping_expr((GroupingExpr *)expr);
                 break;
         case EXPR_LITERAL:
-                resolve_literal_expr((const LiteralExpr *)expr);
+                resolve_literal_expr((LiteralExpr *)expr);
                 break;
         case EXPR_LOGICAL:
-                resolve_logical_expr((const LogicalExpr *)expr);
+                resolve_logical_expr((LogicalExpr *)expr);
                 break;
         case EXPR_SET:
-                resolve_set_expr((const SetExpr *)expr);
+                resolve_set_expr((SetExpr *)expr);
                 break;
         case EXPR_SUPER:
-                resolve_super_expr((const SuperExpr *)expr);
+                resolve_super_expr((SuperExpr *)expr);
                 break;
         case EXPR_THIS:
-                resolve_this_expr((const ThisExpr *)expr);
+                resolve_this_expr((ThisExpr *)expr);
                 break;
         case EXPR_UNARY:
-                resolve_unary_expr((const UnaryExpr *)expr);
+                resolve_unary_expr((UnaryExpr *)expr);
                 break;
         case EXPR_VARIABLE:
-                resolve_variable_expr((const VariableExpr *)expr);
+                resolve_variable_expr((VariableExpr *)expr);
                 break;
         }
 }
 
-static void resolve_stmt(const Stmt *stmt);
+static void resolve_stmt(Stmt *stmt);
 
-static void resolve_block_stmt(const BlockStmt *block_stmt) {
+static void resolve_block_stmt(BlockStmt *block_stmt) {
         begin_scope();
-        resolve_stmts(block_stmt->statements);
-        end_scope();
+        resolve_stmt_list(block_stmt->statements);
+        block_stmt->num_slots = end_scope();
 }
 
-static void resolve_class_stmt(const ClassStmt *class_stmt) {
+static void resolve_class_stmt(ClassStmt *class_stmt) {
         ClassType enclosing_class = resolver.current_class;
         resolver.current_class = CLASS_CLASS;
 
-        declare(class_stmt->name);
+        class_stmt->slot = declare(class_stmt->name, class_stmt->base.line);
         define(class_stmt->name);
 
-        if (class_stmt->superclass != NULL) {
-                if (strcmp(class_stmt->superclass->name->lexeme, class_stmt->name->lexeme) == 0) {
-                        resolve_error(class_stmt->superclass->name, "A class can't inherit from itself.");
+        if (class_stmt->superclass != AST_NULL) {
+                VariableExpr *superclass = ast_node(class_stmt->superclass);
+                if (superclass->name == class_stmt->name) {
+                        resolve_error(superclass->base.line, superclass->name, "A class can't inherit from itself.");
                 }
                 resolver.current_class = CLASS_SUBCLASS;
-                resolve_variable_expr(class_stmt->superclass);
+                resolve_variable_expr(superclass);
                 begin_scope();
-                Map *scope = vector_at_back(resolver.scopes);
-                map_put(scope, "super", (void *)true);
+                add_binding(vector_at_back(resolver.scopes), intern_string("super"), true);
         }
 
-        begin_scope();
-        Map *scope = vector_at_back(resolver.scopes);
-        map_put(scope, "this", (void *)true);
-
-        size_t num_methods = vector_size(class_stmt->methods);
-        for (size_t i = 0; i < num_methods; i++) {
-                FunctionStmt *method = vector_at(class_stmt->methods, i);
-                FunctionType type = strcmp(method->name->lexeme, "init") == 0 ? FUNCTION_INITIALIZER : FUNCTION_METHOD;
+        const AstRef *methods = ast_refs(class_stmt->methods);
+        for (size_t i = 0; i < class_stmt->methods.size; i++) {
+                FunctionStmt *method = ast_node(methods[i]);
+                FunctionType type = strcmp(method->name, "init") == 0 ? FUNCTION_INITIALIZER : FUNCTION_METHOD;
                 resolve_function(method, type);
         }
 
-        end_scope();
-
-        if (class_stmt->superclass != NULL) {
+        if (class_stmt->superclass != AST_NULL) {
                 end_scope();
         }
 
         resolver.current_class = enclosing_class;
 }
 
-static void resolve_expression_stmt(const ExpressionStmt *expression_stmt) {
-        resolve_expr(expression_stmt->expression);
+static void resolve_expression_stmt(ExpressionStmt *expression_stmt) {
+        resolve_expr(ast_node(expression_stmt->expression));
 }
 
-static void resolve_function_stmt(const FunctionStmt *function_stmt) {
-        declare(function_stmt->name);
+static void resolve_function_stmt(FunctionStmt *function_stmt) {
+        function_stmt->slot = declare(function_stmt->name, function_stmt->base.line);
         define(function_stmt->name);
         resolve_function(function_stmt, FUNCTION_FUNCTION);
 }
 
-static void resolve_if_stmt(const IfStmt *if_stmt) {
-        resolve_expr(if_stmt->condition);
-        resolve_stmt(if_stmt->then_branch);
-        if (if_stmt->else_branch != NULL) {
-                resolve_stmt(if_stmt->else_branch);
+static void resolve_if_stmt(IfStmt *if_stmt) {
+        resolve_expr(ast_node(if_stmt->condition));
+        resolve_stmt(ast_node(if_stmt->then_branch));
+        if (if_stmt->else_branch != AST_NULL) {
+                resolve_stmt(ast_node(if_stmt->else_branch));
         }
 }
 
-static void resolve_print_stmt(const PrintStmt *print_stmt) {
-        resolve_expr(print_stmt->expression);
+static void resolve_print_stmt(PrintStmt *print_stmt) {
+        resolve_expr(ast_node(print_stmt->expression));
 }
 
-static void resolve_return_stmt(const ReturnStmt *return_stmt) {
+static void resolve_return_stmt(ReturnStmt *return_stmt) {
         if (resolver.current_function == FUNCTION_NONE) {
-                resolve_error(return_stmt->keyword, "Can't return from top-level code.");
+                resolve_error(return_stmt->base.line, "return", "Can't return from top-level code.");
         }
 
-        if (return_stmt->value != NULL) {
+        if (return_stmt->value != AST_NULL) {
                 if (resolver.current_function == FUNCTION_INITIALIZER) {
-                        resolve_error(return_stmt->keyword, "Can't return a value from an initializer.");
+                        resolve_error(return_stmt->base.line, "return", "Can't return a value from an initializer.");
                 }
-                resolve_expr(return_stmt->value);
+                resolve_expr(ast_node(return_stmt->value));
         }
 }
 
-static void resolve_var_stmt(const VarStmt *var_stmt) {
-        declare(var_stmt->name);
-        if (var_stmt->initializer != NULL) {
-                resolve_expr(var_stmt->initializer);
+static void resolve_var_stmt(VarStmt *var_stmt) {
+        var_stmt->slot = declare(var_stmt->name, var_stmt->base.line);
+        if (var_stmt->initializer != AST_NULL) {
+                resolve_expr(ast_node(var_stmt->initializer));
         }
         define(var_stmt->name);
 }
 
-static void resolve_while_stmt(const WhileStmt *while_stmt) {
-        resolve_expr(while_stmt->condition);
-        resolve_stmt(while_stmt->body);
+static void resolve_while_stmt(WhileStmt *while_stmt) {
+        resolve_expr(ast_node(while_stmt->condition));
+        resolve_stmt(ast_node(while_stmt->body));
 }
 
-static void resolve_stmt(const Stmt *stmt) {
+static void resolve_stmt(Stmt *stmt) {
         switch (stmt->type) {
         case STMT_BLOCK:
-                resolve_block_stmt((const BlockStmt *)stmt);
+                resolve_block_stmt((BlockStmt *)stmt);
                 break;
         case STMT_CLASS:
-                resolve_class_stmt((const ClassStmt *)stmt);
+                resolve_class_stmt((ClassStmt *)stmt);
                 break;
         case STMT_EXPRESSION:
-                resolve_expression_stmt((const ExpressionStmt *)stmt);
+                resolve_expression_stmt((ExpressionStmt *)stmt);
                 break;
         case STMT_FUNCTION:
-                resolve_function_stmt((const FunctionStmt *)stmt);
+                resolve_function_stmt((FunctionStmt *)stmt);
                 break;
         case STMT_IF:
-                resolve_if_stmt((const IfStmt *)stmt);
+                resolve_if_stmt((IfStmt *)stmt);
                 break;
         case STMT_PRINT:
-                resolve_print_stmt((const PrintStmt *)stmt);
+                resolve_print_stmt((PrintStmt *)stmt);
                 break;
         case STMT_RETURN:
-                resolve_return_stmt((const ReturnStmt *)stmt);
+                resolve_return_stmt((ReturnStmt *)stmt);
                 break;
         case STMT_VAR:
-                resolve_var_stmt((const VarStmt *)stmt);
+                resolve_var_stmt((VarStmt *)stmt);
                 break;
         case STMT_WHILE:
-                resolve_while_stmt((const WhileStmt *)stmt);
+                resolve_while_stmt((WhileStmt *)stmt);
                 break;
         }
 }
 
-void resolve_stmts(const Vector *statements) {
-        init();
-        size_t num_statements = vector_size(statements);
-        for (size_t i = 0; i < num_statements; i++) {
-                resolve_stmt(vector_at(statements, i));
+static void resolve_stmt_list(AstList statements) {
+        const AstRef *refs = ast_refs(statements);
+        for (size_t i = 0; i < statements.size; i++) {
+                resolve_stmt(ast_node(refs[i]));
         }
 }
+
+void resolve_stmts(AstList statements) {
+        init();
+        resolve_stmt_list(statements);
+}
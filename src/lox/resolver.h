@@ -1,8 +1,8 @@
 #ifndef CODECRAFTERS_INTERPRETER_LOX_RESOLVER_H
 #define CODECRAFTERS_INTERPRETER_LOX_RESOLVER_H
 
-#include "util/vector.h"
+#include "lox/ast.h"
 
-void resolve_stmts(const Vector *statements);
+void resolve_stmts(AstList statements);
 
 #endif
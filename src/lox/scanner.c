@@ -1,10 +1,9 @@
 #include "lox/scanner.h"
 #include "lox/errors.h"
+#include "lox/scanner_simd.h"
 #include "lox/token.h"
-#include "util/vector.h"
 #include "util/xmalloc.h"
 
-#include <ctype.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -14,15 +13,15 @@
 static struct {
         const char *start;
         const char *current;
-        Vector *tokens;
+        Token *token;
+        bool has_token;
         bool has_error;
         size_t line;
 } scanner;
 
-static void init(const char *source) {
+void scanner_init(const char *source) {
         scanner.start = source;
         scanner.current = source;
-        scanner.tokens = vector_construct();
         scanner.has_error = false;
         scanner.line = 1;
 }
@@ -51,32 +50,29 @@ static char peek_next(void) {
         return is_at_end() ? '\0' : *(scanner.current + 1);
 }
 
-static char *get_lexeme(void) {
-        size_t lexeme_length = scanner.current - scanner.start;
-        return xstrndup(scanner.start, lexeme_length);
+static size_t lexeme_length(void) {
+        return scanner.current - scanner.start;
 }
 
-static void add_token_complete(TokenType type, char *lexeme, Object *literal) {
-        Token *token = token_construct(type, lexeme, literal, scanner.line);
-        vector_push_back(scanner.tokens, token);
+static void add_token_complete(TokenType type, Object *literal) {
+        scanner.token->type = type;
+        scanner.token->length = lexeme_length();
+        scanner.token->lexeme = scanner.start;
+        scanner.token->literal = literal;
+        scanner.token->line = scanner.line;
+        scanner.has_token = true;
 }
 
 static void add_token(TokenType type) {
-        add_token_complete(type, get_lexeme(), NULL);
+        add_token_complete(type, NULL);
 }
 
 static void comment(void) {
-        while (!is_at_end() && peek() != '\n') {
-                advance();
-        }
+        scanner.current = skip_comment(scanner.current);
 }
 
 static void string(void) {
-        while (!is_at_end() && peek() != '\"') {
-                if (advance() == '\n') {
-                        scanner.line++;
-                }
-        }
+        scanner.current = skip_string(scanner.current, &scanner.line);
 
         if (is_at_end()) {
                 scan_error(scanner.line, "Unterminated string.");
@@ -84,75 +80,99 @@ static void string(void) {
                 return;
         }
         advance();
+        add_token(TOKEN_STRING);
+}
 
-        char *lexeme = get_lexeme();
-        char *unquoted_lexeme = xstrndup(lexeme + 1, strlen(lexeme) - 2);
-        Object *literal = string_object_construct(unquoted_lexeme);
-        add_token_complete(TOKEN_STRING, lexeme, literal);
+static bool is_digit(char c) {
+        return c >= '0' && c <= '9';
 }
 
 static void number(void) {
-        while (isdigit(peek())) {
+        while (is_digit(peek())) {
                 advance();
         }
 
-        if (peek() == '.' && isdigit(peek_next())) {
+        if (peek() == '.' && is_digit(peek_next())) {
                 advance();
-                while (isdigit(peek())) {
+                while (is_digit(peek())) {
                         advance();
                 }
         }
 
-        char *lexeme = get_lexeme();
-        Object *literal = number_object_construct(atof(lexeme));
-        add_token_complete(TOKEN_NUMBER, lexeme, literal);
+        char buffer[64];
+        size_t length = lexeme_length();
+        char *digits = length < sizeof(buffer) ? buffer : xmalloc(length + 1);
+        memcpy(digits, scanner.start, length);
+        digits[length] = '\0';
+        Object *literal = number_object_construct(atof(digits));
+        if (digits != buffer) {
+                free(digits);
+        }
+        add_token_complete(TOKEN_NUMBER, literal);
 }
 
 static bool is_alpha_numeric(char c) {
-        return c == '_' || isalnum(c);
-}
-
-static TokenType identifier_or_keyword(const char *lexeme) {
-        typedef struct {
-                const char *lexeme;
-                TokenType type;
-        } Keyword;
-
-        static const Keyword keywords[] = {
-                {"and", TOKEN_AND},
-                {"class", TOKEN_CLASS},
-                {"else", TOKEN_ELSE},
-                {"false", TOKEN_FALSE},
-                {"for", TOKEN_FOR},
-                {"fun", TOKEN_FUN},
-                {"if", TOKEN_IF},
-                {"nil", TOKEN_NIL},
-                {"or", TOKEN_OR},
-                {"print", TOKEN_PRINT},
-                {"return", TOKEN_RETURN},
-                {"super", TOKEN_SUPER},
-                {"this", TOKEN_THIS},
-                {"true", TOKEN_TRUE},
-                {"var", TOKEN_VAR},
-                {"while", TOKEN_WHILE},
-        };
-        const size_t num_keywords = sizeof(keywords) / sizeof(Keyword);
-
-        for (size_t i = 0; i < num_keywords; i++) {
-                if (strcmp(lexeme, keywords[i].lexeme) == 0) {
-                        return keywords[i].type;
+        return char_in_class(c, CLASS_IDENTIFIER);
+}
+
+static TokenType check_keyword(const char *chars, size_t length, const char *keyword, TokenType type) {
+        size_t keyword_length = strlen(keyword);
+        return length == keyword_length && memcmp(chars, keyword, length) == 0 ? type : TOKEN_IDENTIFIER;
+}
+
+static TokenType identifier_or_keyword(const char *chars, size_t length) {
+        switch (chars[0]) {
+        case 'a':
+                return check_keyword(chars, length, "and", TOKEN_AND);
+        case 'c':
+                return check_keyword(chars, length, "class", TOKEN_CLASS);
+        case 'e':
+                return check_keyword(chars, length, "else", TOKEN_ELSE);
+        case 'f':
+                if (length > 1) {
+                        switch (chars[1]) {
+                        case 'a':
+                                return check_keyword(chars, length, "false", TOKEN_FALSE);
+                        case 'o':
+                                return check_keyword(chars, length, "for", TOKEN_FOR);
+                        case 'u':
+                                return check_keyword(chars, length, "fun", TOKEN_FUN);
+                        }
                 }
+                break;
+        case 'i':
+                return check_keyword(chars, length, "if", TOKEN_IF);
+        case 'n':
+                return check_keyword(chars, length, "nil", TOKEN_NIL);
+        case 'o':
+                return check_keyword(chars, length, "or", TOKEN_OR);
+        case 'p':
+                return check_keyword(chars, length, "print", TOKEN_PRINT);
+        case 'r':
+                return check_keyword(chars, length, "return", TOKEN_RETURN);
+        case 's':
+                return check_keyword(chars, length, "super", TOKEN_SUPER);
+        case 't':
+                if (length > 1) {
+                        switch (chars[1]) {
+                        case 'h':
+                                return check_keyword(chars, length, "this", TOKEN_THIS);
+                        case 'r':
+                                return check_keyword(chars, length, "true", TOKEN_TRUE);
+                        }
+                }
+                break;
+        case 'v':
+                return check_keyword(chars, length, "var", TOKEN_VAR);
+        case 'w':
+                return check_keyword(chars, length, "while", TOKEN_WHILE);
         }
         return TOKEN_IDENTIFIER;
 }
 
 static void identifier(void) {
-        while (is_alpha_numeric(peek())) {
-                advance();
-        }
-
-        char *lexeme = get_lexeme();
-        add_token_complete(identifier_or_keyword(lexeme), lexeme, NULL);
+        scanner.current = skip_identifier(scanner.current);
+        add_token(identifier_or_keyword(scanner.start, lexeme_length()));
 }
 
 static void scan_token(void) {
@@ -207,16 +227,11 @@ static void scan_token(void) {
                         add_token(TOKEN_SLASH);
                 }
                 break;
-        case '\n':
-                scanner.line++;
-                break;
         case '\"':
                 string();
                 break;
         default:
-                if (isspace(c)) {
-                        break;
-                } else if (isdigit(c)) {
+                if (is_digit(c)) {
                         number();
                 } else if (is_alpha_numeric(c)) {
                         identifier();
@@ -227,14 +242,18 @@ static void scan_token(void) {
         }
 }
 
-Vector *scan_tokens(const char *source) {
-        init(source);
-        while (!is_at_end()) {
-                scan_token();
+void scanner_next(Token *token) {
+        scanner.token = token;
+        scanner.has_token = false;
+        while (!scanner.has_token) {
+                scanner.current = skip_whitespace(scanner.current, &scanner.line);
                 scanner.start = scanner.current;
+                if (is_at_end()) {
+                        add_token(TOKEN_EOF);
+                } else {
+                        scan_token();
+                }
         }
-        add_token(TOKEN_EOF);
-        return scanner.tokens;
 }
 
 bool has_scan_error(void) {
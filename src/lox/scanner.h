@@ -3,9 +3,10 @@
 
 #include <stdbool.h>
 
-#include "util/vector.h"
+#include "lox/token.h"
 
-Vector *scan_tokens(const char *source);
+void scanner_init(const char *source);
+void scanner_next(Token *token);
 bool has_scan_error(void);
 
 #endif
@@ -0,0 +1,149 @@
+#include "lox/scanner_simd.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_SIMD
+#endif
+
+typedef const char *(*Skipper)(const char *p, CharClass class, size_t *line);
+
+static const char *skip_scalar(const char *p, CharClass class, size_t *line) {
+        for ( ; char_in_class(*p, class); p++) {
+                if (*p == '\n') {
+                        (*line)++;
+                }
+        }
+        return p;
+}
+
+#ifdef HAVE_SIMD
+
+#define BLOCK_SIZE 32
+#define PAGE_SIZE 4096
+
+#define SIMD_INLINE static inline __attribute__((always_inline, no_sanitize_address))
+
+typedef signed char Block __attribute__((vector_size(BLOCK_SIZE)));
+typedef uint32_t (*MoveMask)(const Block *block);
+
+SIMD_INLINE void classify(const Block *block, CharClass class, Block *result) {
+        Block lower = *block | 0x20;
+        switch (class) {
+        case CLASS_COMMENT:
+                *result = (*block != '\n') & (*block != '\0');
+                break;
+        case CLASS_IDENTIFIER:
+                *result = (*block == '_') | ((*block >= '0') & (*block <= '9')) | ((lower >= 'a') & (lower <= 'z'));
+                break;
+        case CLASS_STRING:
+                *result = (*block != '\"') & (*block != '\0');
+                break;
+        case CLASS_WHITESPACE:
+                *result = (*block == ' ') | ((*block >= '\t') & (*block <= '\r'));
+                break;
+        }
+}
+
+SIMD_INLINE const char *skip_blocks(const char *p, CharClass class, size_t *line, MoveMask move_mask) {
+        while (true) {
+                if (((uintptr_t)p & (PAGE_SIZE - 1)) > PAGE_SIZE - BLOCK_SIZE) {
+                        if (!char_in_class(*p, class)) {
+                                return p;
+                        }
+                        if (*p++ == '\n') {
+                                (*line)++;
+                        }
+                        continue;
+                }
+
+                Block block;
+                memcpy(&block, p, BLOCK_SIZE);
+                Block in_class_mask;
+                classify(&block, class, &in_class_mask);
+                uint32_t stop = ~move_mask(&in_class_mask);
+                uint32_t newlines = 0;
+                if (class == CLASS_STRING || class == CLASS_WHITESPACE) {
+                        Block newline_mask = block == '\n';
+                        newlines = move_mask(&newline_mask);
+                }
+                if (stop != 0) {
+                        int length = __builtin_ctz(stop);
+                        *line += __builtin_popcount(newlines & ((1u << length) - 1));
+                        return p + length;
+                }
+                *line += __builtin_popcount(newlines);
+                p += BLOCK_SIZE;
+        }
+}
+
+SIMD_INLINE uint32_t move_mask_sse2(const Block *block) {
+        __m128i low;
+        __m128i high;
+        memcpy(&low, block, sizeof(low));
+        memcpy(&high, (const char *)block + sizeof(low), sizeof(high));
+        return (uint32_t)_mm_movemask_epi8(low) | (uint32_t)_mm_movemask_epi8(high) << 16;
+}
+
+__attribute__((no_sanitize_address))
+static const char *skip_sse2(const char *p, CharClass class, size_t *line) {
+        switch (class) {
+        case CLASS_COMMENT:
+                return skip_blocks(p, CLASS_COMMENT, line, move_mask_sse2);
+        case CLASS_IDENTIFIER:
+                return skip_blocks(p, CLASS_IDENTIFIER, line, move_mask_sse2);
+        case CLASS_STRING:
+                return skip_blocks(p, CLASS_STRING, line, move_mask_sse2);
+        case CLASS_WHITESPACE:
+                return skip_blocks(p, CLASS_WHITESPACE, line, move_mask_sse2);
+        }
+        return p;
+}
+
+__attribute__((target("avx2")))
+SIMD_INLINE uint32_t move_mask_avx2(const Block *block) {
+        __m256i vector;
+        memcpy(&vector, block, sizeof(vector));
+        return _mm256_movemask_epi8(vector);
+}
+
+__attribute__((target("avx2"), no_sanitize_address))
+static const char *skip_avx2(const char *p, CharClass class, size_t *line) {
+        switch (class) {
+        case CLASS_COMMENT:
+                return skip_blocks(p, CLASS_COMMENT, line, move_mask_avx2);
+        case CLASS_IDENTIFIER:
+                return skip_blocks(p, CLASS_IDENTIFIER, line, move_mask_avx2);
+        case CLASS_STRING:
+                return skip_blocks(p, CLASS_STRING, line, move_mask_avx2);
+        case CLASS_WHITESPACE:
+                return skip_blocks(p, CLASS_WHITESPACE, line, move_mask_avx2);
+        }
+        return p;
+}
+
+#endif
+
+static struct {
+        bool is_initialized;
+        Skipper skip;
+} dispatch;
+
+static void init(void) {
+        dispatch.skip = skip_scalar;
+#ifdef HAVE_SIMD
+        __builtin_cpu_init();
+        dispatch.skip = __builtin_cpu_supports("avx2") ? skip_avx2 : skip_sse2;
+#endif
+        dispatch.is_initialized = true;
+}
+
+const char *skip_run(const char *p, CharClass class, size_t *line) {
+        if (!dispatch.is_initialized) {
+                init();
+        }
+        return dispatch.skip(p, class, line);
+}
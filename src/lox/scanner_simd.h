@@ -0,0 +1,62 @@
+#ifndef CODECRAFTERS_INTERPRETER_LOX_SCANNER_SIMD_H
+#define CODECRAFTERS_INTERPRETER_LOX_SCANNER_SIMD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SCALAR_PREFIX 16
+
+typedef enum {
+        CLASS_COMMENT,
+        CLASS_IDENTIFIER,
+        CLASS_STRING,
+        CLASS_WHITESPACE,
+} CharClass;
+
+const char *skip_run(const char *p, CharClass class, size_t *line);
+
+static inline bool char_in_class(char c, CharClass class) {
+        switch (class) {
+        case CLASS_COMMENT:
+                return c != '\n' && c != '\0';
+        case CLASS_IDENTIFIER:
+                return c == '_' || (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z');
+        case CLASS_STRING:
+                return c != '\"' && c != '\0';
+        case CLASS_WHITESPACE:
+                return c == ' ' || (c >= '\t' && c <= '\r');
+        }
+        return false;
+}
+
+static inline const char *skip_class(const char *p, CharClass class, size_t *line) {
+        for (size_t i = 0; i < SCALAR_PREFIX; i++, p++) {
+                if (!char_in_class(*p, class)) {
+                        return p;
+                }
+                if (*p == '\n') {
+                        (*line)++;
+                }
+        }
+        return skip_run(p, class, line);
+}
+
+static inline const char *skip_whitespace(const char *p, size_t *line) {
+        return skip_class(p, CLASS_WHITESPACE, line);
+}
+
+static inline const char *skip_comment(const char *p) {
+        size_t line = 0;
+        return skip_class(p, CLASS_COMMENT, &line);
+}
+
+static inline const char *skip_string(const char *p, size_t *line) {
+        return skip_class(p, CLASS_STRING, line);
+}
+
+static inline const char *skip_identifier(const char *p) {
+        size_t line = 0;
+        return skip_class(p, CLASS_IDENTIFIER, &line);
+}
+
+#endif
@@ -0,0 +1,72 @@
+#include "lox/shape.h"
+#include "util/map.h"
+#include "util/xmalloc.h"
+
+#define SHAPE_MAP_THRESHOLD 8
+
+static Shape *shape_construct(Shape *parent, const char *name) {
+        Shape *shape = xmalloc(sizeof(Shape));
+        shape->parent = parent;
+        shape->name = name;
+        shape->num_fields = parent == NULL ? 0 : parent->num_fields + 1;
+        shape->slots = NULL;
+        shape->has_extended_slots = false;
+        shape->transitions = NULL;
+        return shape;
+}
+
+Shape *shape_root(void) {
+        static Shape *root = NULL;
+        if (root == NULL) {
+                root = shape_construct(NULL, NULL);
+        }
+        return root;
+}
+
+bool shape_find(const Shape *shape, const char *name, size_t *slot) {
+        if (shape->slots != NULL) {
+                void *value;
+                if (map_find(shape->slots, name, &value) && (size_t)value < shape->num_fields) {
+                        *slot = (size_t)value;
+                        return true;
+                }
+                return false;
+        }
+        for (; shape->parent != NULL; shape = shape->parent) {
+                if (shape->name == name) {
+                        *slot = shape->num_fields - 1;
+                        return true;
+                }
+        }
+        return false;
+}
+
+static void build_slots(Shape *shape) {
+        Shape *parent = shape->parent;
+        if (parent->slots != NULL && !parent->has_extended_slots) {
+                shape->slots = parent->slots;
+                parent->has_extended_slots = true;
+        } else {
+                shape->slots = map_construct(ptr_hash, ptr_compare);
+                for (const Shape *ancestor = parent; ancestor->parent != NULL; ancestor = ancestor->parent) {
+                        map_put(shape->slots, ancestor->name, (void *)(ancestor->num_fields - 1));
+                }
+        }
+        map_put(shape->slots, shape->name, (void *)(shape->num_fields - 1));
+}
+
+Shape *shape_transition(Shape *shape, const char *name) {
+        void *value;
+        if (shape->transitions == NULL) {
+                shape->transitions = map_construct(ptr_hash, ptr_compare);
+        } else if (map_find(shape->transitions, name, &value)) {
+                return value;
+        }
+
+        Shape *child = shape_construct(shape, name);
+        if (child->num_fields > SHAPE_MAP_THRESHOLD) {
+                build_slots(child);
+        }
+        map_put(shape->transitions, name, child);
+        return child;
+}
@@ -0,0 +1,27 @@
+#ifndef CODECRAFTERS_INTERPRETER_LOX_SHAPE_H
+#define CODECRAFTERS_INTERPRETER_LOX_SHAPE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util/map.h"
+
+#define SHAPE_NO_SLOT SIZE_MAX
+
+typedef struct Shape Shape;
+
+struct Shape {
+        Shape *parent;
+        const char *name;
+        size_t num_fields;
+        Map *slots;
+        bool has_extended_slots;
+        Map *transitions;
+};
+
+Shape *shape_root(void);
+bool shape_find(const Shape *shape, const char *name, size_t *slot);
+Shape *shape_transition(Shape *shape, const char *name);
+
+#endif
@@ -1,75 +1,78 @@
 #include "lox/stmt.h"
+#include "lox/ast.h"
 #include "lox/expr.h"
-#include "util/xmalloc.h"
 
-BlockStmt *block_stmt_construct(Vector *statements) {
-        BlockStmt *block_stmt = xmalloc(sizeof(BlockStmt));
-        block_stmt->base.type = STMT_BLOCK;
+static void *stmt_allocate(size_t size, StmtType type, size_t line) {
+        Stmt *stmt = ast_allocate(size);
+        stmt->type = type;
+        stmt->handler = 0;
+        stmt->line = line;
+        return stmt;
+}
+
+BlockStmt *block_stmt_construct(AstList statements) {
+        BlockStmt *block_stmt = stmt_allocate(sizeof(BlockStmt), STMT_BLOCK, 0);
         block_stmt->statements = statements;
+        block_stmt->num_slots = 0;
         return block_stmt;
 }
 
-ClassStmt *class_stmt_construct(Token *name, VariableExpr *superclass, Vector *methods) {
-        ClassStmt *class_stmt = xmalloc(sizeof(ClassStmt));
-        class_stmt->base.type = STMT_CLASS;
+ClassStmt *class_stmt_construct(const char *name, size_t line, VariableExpr *superclass, AstList methods) {
+        ClassStmt *class_stmt = stmt_allocate(sizeof(ClassStmt), STMT_CLASS, line);
         class_stmt->name = name;
-        class_stmt->superclass = superclass;
+        class_stmt->superclass = ast_ref(superclass);
         class_stmt->methods = methods;
+        class_stmt->slot = 0;
         return class_stmt;
 }
 
 ExpressionStmt *expression_stmt_construct(Expr *expression) {
-        ExpressionStmt *expression_stmt = xmalloc(sizeof(ExpressionStmt));
-        expression_stmt->base.type = STMT_EXPRESSION;
-        expression_stmt->expression = expression;
+        ExpressionStmt *expression_stmt = stmt_allocate(sizeof(ExpressionStmt), STMT_EXPRESSION, 0);
+        expression_stmt->expression = ast_ref(expression);
         return expression_stmt;
 }
 
-FunctionStmt *function_stmt_construct(Token *name, Vector *params, Vector *body) {
-        FunctionStmt *function_stmt = xmalloc(sizeof(FunctionStmt));
-        function_stmt->base.type = STMT_FUNCTION;
+FunctionStmt *function_stmt_construct(const char *name, size_t line, AstList params, AstList body) {
+        FunctionStmt *function_stmt = stmt_allocate(sizeof(FunctionStmt), STMT_FUNCTION, line);
         function_stmt->name = name;
         function_stmt->params = params;
         function_stmt->body = body;
+        function_stmt->slot = 0;
+        function_stmt->num_slots = 0;
         return function_stmt;
 }
 
 IfStmt *if_stmt_construct(Expr *condition, Stmt *then_branch, Stmt *else_branch) {
-        IfStmt *if_stmt = xmalloc(sizeof(IfStmt));
-        if_stmt->base.type = STMT_IF;
-        if_stmt->condition = condition;
-        if_stmt->then_branch = then_branch;
-        if_stmt->else_branch = else_branch;
+        IfStmt *if_stmt = stmt_allocate(sizeof(IfStmt), STMT_IF, 0);
+        if_stmt->condition = ast_ref(condition);
+        if_stmt->then_branch = ast_ref(then_branch);
+        if_stmt->else_branch = ast_ref(else_branch);
         return if_stmt;
 }
 
 PrintStmt *print_stmt_construct(Expr *expression) {
-        PrintStmt *print_stmt = xmalloc(sizeof(PrintStmt));
-        print_stmt->base.type = STMT_PRINT;
-        print_stmt->expression = expression;
+        PrintStmt *print_stmt = stmt_allocate(sizeof(PrintStmt), STMT_PRINT, 0);
+        print_stmt->expression = ast_ref(expression);
         return print_stmt;
 }
 
-ReturnStmt *return_stmt_construct(Token *keyword, Expr *value) {
-        ReturnStmt *return_stmt = xmalloc(sizeof(ReturnStmt));
-        return_stmt->base.type = STMT_RETURN;
-        return_stmt->keyword = keyword;
-        return_stmt->value = value;
+ReturnStmt *return_stmt_construct(size_t line, Expr *value) {
+        ReturnStmt *return_stmt = stmt_allocate(sizeof(ReturnStmt), STMT_RETURN, line);
+        return_stmt->value = ast_ref(value);
         return return_stmt;
 }
 
-VarStmt *var_stmt_construct(Token *name, Expr *initializer) {
-        VarStmt *var_stmt = xmalloc(sizeof(VarStmt));
-        var_stmt->base.type = STMT_VAR;
+VarStmt *var_stmt_construct(const char *name, size_t line, Expr *initializer) {
+        VarStmt *var_stmt = stmt_allocate(sizeof(VarStmt), STMT_VAR, line);
         var_stmt->name = name;
-        var_stmt->initializer = initializer;
+        var_stmt->initializer = ast_ref(initializer);
+        var_stmt->slot = 0;
         return var_stmt;
 }
 
 WhileStmt *while_stmt_construct(Expr *condition, Stmt *body) {
-        WhileStmt *while_stmt = xmalloc(sizeof(WhileStmt));
-        while_stmt->base.type = STMT_WHILE;
-        while_stmt->condition = condition;
-        while_stmt->body = body;
+        WhileStmt *while_stmt = stmt_allocate(sizeof(WhileStmt), STMT_WHILE, 0);
+        while_stmt->condition = ast_ref(condition);
+        while_stmt->body = ast_ref(body);
         return while_stmt;
 }
@@ -1,9 +1,11 @@
 #ifndef CODECRAFTERS_INTERPRETER_LOX_STMT_H
 #define CODECRAFTERS_INTERPRETER_LOX_STMT_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lox/ast.h"
 #include "lox/expr.h"
-#include "lox/token.h"
-#include "util/vector.h"
 
 typedef enum {
         STMT_BLOCK,
@@ -18,77 +20,83 @@ typedef enum {
 } StmtType;
 
 typedef struct {
-        StmtType type;
+        StmtType type : 8;
+        uint8_t handler;
+        uint32_t line;
 } Stmt;
 
 typedef struct {
         Stmt base;
-        Vector *statements;
+        AstList statements;
+        uint32_t num_slots;
 } BlockStmt;
 
-BlockStmt *block_stmt_construct(Vector *statements);
+BlockStmt *block_stmt_construct(AstList statements);
 
 typedef struct {
         Stmt base;
-        Token *name;
-        VariableExpr *superclass;
-        Vector *methods;
+        const char *name;
+        AstRef superclass;
+        uint32_t slot;
+        AstList methods;
 } ClassStmt;
 
-ClassStmt *class_stmt_construct(Token *name, VariableExpr *superclass, Vector *methods);
+ClassStmt *class_stmt_construct(const char *name, size_t line, VariableExpr *superclass, AstList methods);
 
 typedef struct {
         Stmt base;
-        Expr *expression;
+        AstRef expression;
 } ExpressionStmt;
 
 ExpressionStmt *expression_stmt_construct(Expr *expression);
 
 typedef struct {
         Stmt base;
-        Token *name;
-        Vector *params;
-        Vector *body;
+        const char *name;
+        AstList params;
+        AstList body;
+        uint32_t slot;
+        uint32_t num_slots;
 } FunctionStmt;
 
-FunctionStmt *function_stmt_construct(Token *name, Vector *params, Vector *body);
+FunctionStmt *function_stmt_construct(const char *name, size_t line, AstList params, AstList body);
 
 typedef struct {
         Stmt base;
-        Expr *condition;
-        Stmt *then_branch;
-        Stmt *else_branch;
+        AstRef condition;
+        AstRef then_branch;
+        AstRef else_branch;
 } IfStmt;
 
 IfStmt *if_stmt_construct(Expr *condition, Stmt *then_branch, Stmt *else_branch);
 
 typedef struct {
         Stmt base;
-        Expr *expression;
+        AstRef expression;
 } PrintStmt;
 
 PrintStmt *print_stmt_construct(Expr *expression);
 
 typedef struct {
         Stmt base;
-        Token *keyword;
-        Expr *value;
+        AstRef value;
 } ReturnStmt;
 
-ReturnStmt *return_stmt_construct(Token *keyword, Expr *value);
+ReturnStmt *return_stmt_construct(size_t line, Expr *value);
 
 typedef struct {
         Stmt base;
-        Token *name;
-        Expr *initializer;
+        const char *name;
+        AstRef initializer;
+        uint32_t slot;
 } VarStmt;
 
-VarStmt *var_stmt_construct(Token *name, Expr *initializer);
+VarStmt *var_stmt_construct(const char *name, size_t line, Expr *initializer);
 
 typedef struct {
         Stmt base;
-        Expr *condition;
-        Stmt *body;
+        AstRef condition;
+        AstRef body;
 } WhileStmt;
 
 WhileStmt *while_stmt_construct(Expr *condition, Stmt *body);
@@ -1,15 +1,13 @@
 #include "lox/token.h"
-#include "util/xmalloc.h"
+#include "util/intern.h"
 
 #include <stdio.h>
 
-Token *token_construct(TokenType type, char *lexeme, Object *literal, size_t line) {
-        Token *token = xmalloc(sizeof(Token));
-        token->type = type;
-        token->lexeme = lexeme;
-        token->literal = literal;
-        token->line = line;
-        return token;
+Object *token_literal(const Token *token) {
+        if (token->type == TOKEN_STRING) {
+                return string_object_construct(intern(token->lexeme + 1, token->length - 2));
+        }
+        return token->literal;
 }
 
 static const char *token_type_to_string(TokenType type) {
@@ -97,7 +95,13 @@ static const char *token_type_to_string(TokenType type) {
 
 const char *token_to_string(const Token *token) {
         static char str[256];
-        const char *literal_str = token->literal == NULL ? "null" : object_to_string(token->literal);
-        snprintf(str, sizeof(str), "%s %s %s", token_type_to_string(token->type), token->lexeme, literal_str);
+        const char *type = token_type_to_string(token->type);
+        int length = token->length;
+        if (token->type == TOKEN_STRING) {
+                snprintf(str, sizeof(str), "%s %.*s %.*s", type, length, token->lexeme, length - 2, token->lexeme + 1);
+        } else {
+                const char *literal_str = token->literal == NULL ? "null" : object_to_string(token->literal);
+                snprintf(str, sizeof(str), "%s %.*s %s", type, length, token->lexeme, literal_str);
+        }
         return str;
 }
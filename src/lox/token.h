@@ -2,6 +2,7 @@
 #define CODECRAFTERS_INTERPRETER_LOX_TOKEN_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "lox/object.h"
 
@@ -49,12 +50,13 @@ typedef enum {
 
 typedef struct {
         TokenType type;
-        char *lexeme;
+        uint32_t length;
+        const char *lexeme;
         Object *literal;
         size_t line;
 } Token;
 
-Token *token_construct(TokenType type, char *lexeme, Object *literal, size_t line);
+Object *token_literal(const Token *token);
 const char *token_to_string(const Token *token);
 
 #endif
@@ -0,0 +1,609 @@
+#include "lox/vm.h"
+#include "lox/chunk.h"
+#include "lox/errors.h"
+#include "lox/gc.h"
+#include "lox/jit.h"
+#include "lox/lox_callable.h"
+#include "lox/lox_class.h"
+#include "lox/lox_closure.h"
+#include "lox/lox_instance.h"
+#include "lox/object.h"
+#include "util/intern.h"
+#include "util/map.h"
+#include "util/vector.h"
+#include "util/xmalloc.h"
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FRAMES_MAX (1 << 16)
+#define JIT_THRESHOLD 1000
+
+static struct {
+        CallFrame *frames;
+        size_t num_frames;
+        size_t frames_capacity;
+        Object **stack;
+        Object **stack_top;
+        size_t stack_capacity;
+        Map *globals;
+        Upvalue *open_upvalues;
+        bool is_jit_disabled;
+        size_t jit_threshold;
+} vm = {.jit_threshold = JIT_THRESHOLD};
+
+static void mark_roots(void) {
+        for (Object **slot = vm.stack; slot < vm.stack_top; slot++) {
+                gc_mark(*slot);
+        }
+        for (size_t i = 0; i < vm.num_frames; i++) {
+                gc_mark(vm.frames[i].closure);
+        }
+        gc_mark_values(vm.globals);
+        for (Upvalue *upvalue = vm.open_upvalues; upvalue != NULL; upvalue = upvalue->next) {
+                gc_mark(upvalue);
+        }
+}
+
+static void init(void) {
+        static bool initialized = false;
+        if (initialized) {
+                return;
+        }
+
+        gc_enable(mark_roots);
+
+        vm.frames_capacity = 64;
+        vm.frames = xmalloc(sizeof(CallFrame) * vm.frames_capacity);
+        vm.num_frames = 0;
+        vm.stack_capacity = 1024;
+        vm.stack = xmalloc(sizeof(Object *) * vm.stack_capacity);
+        vm.stack_top = vm.stack;
+        vm.globals = map_construct(ptr_hash, ptr_compare);
+        LoxClock *lox_clock = lox_clock_construct();
+        map_put(vm.globals, intern_string("clock"), lox_callable_object_construct((LoxCallable *)lox_clock));
+        vm.open_upvalues = NULL;
+
+        initialized = true;
+}
+
+static void push(Object *object) {
+        *vm.stack_top++ = object;
+}
+
+static Object *pop(void) {
+        return *--vm.stack_top;
+}
+
+static Object *peek(size_t distance) {
+        return vm.stack_top[-1 - distance];
+}
+
+static Object **rebase(Object **pointer, const Object **old_stack) {
+        return vm.stack + ((uintptr_t)pointer - (uintptr_t)old_stack) / sizeof(Object *);
+}
+
+static void reserve_stack(size_t num_slots) {
+        size_t used = vm.stack_top - vm.stack;
+        if (used + num_slots <= vm.stack_capacity) {
+                return;
+        }
+
+        size_t new_capacity = vm.stack_capacity;
+        while (used + num_slots > new_capacity) {
+                new_capacity *= 2;
+        }
+        const Object **old_stack = (const Object **)vm.stack;
+        vm.stack = xrealloc(vm.stack, sizeof(Object *) * new_capacity);
+        vm.stack_capacity = new_capacity;
+        vm.stack_top = vm.stack + used;
+
+        for (size_t i = 0; i < vm.num_frames; i++) {
+                vm.frames[i].slots = rebase(vm.frames[i].slots, old_stack);
+        }
+        for (Upvalue *upvalue = vm.open_upvalues; upvalue != NULL; upvalue = upvalue->next) {
+                upvalue->location = rebase(upvalue->location, old_stack);
+        }
+}
+
+static LoxClosure *find_method(const LoxClass *class, const char *name) {
+        void *method;
+        return map_find(class->methods, name, &method) ? method : NULL;
+}
+
+static void warm_up(Prototype *prototype) {
+#ifdef LOX_JIT
+        if (vm.is_jit_disabled || prototype->jit_code != NULL) {
+                return;
+        }
+        if (prototype->hotness++ >= vm.jit_threshold) {
+                prototype->jit_code = jit_compile(prototype, vm.globals);
+        }
+#else
+        (void)prototype;
+#endif
+}
+
+static void call_closure(LoxClosure *closure, size_t num_arguments, size_t line) {
+        Prototype *prototype = closure->prototype;
+        if (num_arguments != prototype->arity) {
+                vm_error(line, "Expected %zu arguments but got %zu.", prototype->arity, num_arguments);
+        }
+        if (vm.num_frames == FRAMES_MAX) {
+                vm_error(line, "Stack overflow.");
+        }
+
+        size_t base = vm.stack_top - vm.stack - num_arguments - 1;
+        reserve_stack(prototype->max_stack);
+        if (vm.num_frames == vm.frames_capacity) {
+                vm.frames_capacity *= 2;
+                vm.frames = xrealloc(vm.frames, sizeof(CallFrame) * vm.frames_capacity);
+        }
+
+        CallFrame *frame = &vm.frames[vm.num_frames++];
+        frame->closure = closure;
+        frame->ip = prototype->chunk.code;
+        frame->slots = vm.stack + base;
+        warm_up(prototype);
+}
+
+static void call_value(Object *callee, size_t num_arguments, size_t line) {
+        if (!object_is_lox_callable(callee)) {
+                vm_error(line, "Can only call functions and classes.");
+        }
+
+        LoxCallable *callable = object_as_lox_callable(callee);
+        switch (callable->type) {
+        case LOX_CALLABLE_BOUND_METHOD: {
+                LoxBoundMethod *bound_method = (LoxBoundMethod *)callable;
+                vm.stack_top[-1 - (ptrdiff_t)num_arguments] = bound_method->receiver;
+                call_closure(bound_method->method, num_arguments, line);
+                return;
+        }
+        case LOX_CALLABLE_CLASS: {
+                LoxClass *class = (LoxClass *)callable;
+                LoxInstance *instance = lox_instance_construct(class);
+                vm.stack_top[-1 - (ptrdiff_t)num_arguments] = lox_instance_object_construct(instance);
+                if (class->initializer != NULL) {
+                        call_closure((LoxClosure *)class->initializer, num_arguments, line);
+                } else if (num_arguments != 0) {
+                        vm_error(line, "Expected 0 arguments but got %zu.", num_arguments);
+                }
+                return;
+        }
+        case LOX_CALLABLE_CLOCK: {
+                if (num_arguments != 0) {
+                        vm_error(line, "Expected 0 arguments but got %zu.", num_arguments);
+                }
+                vm.stack_top[-1] = lox_callable_call(callable, NULL);
+                return;
+        }
+        case LOX_CALLABLE_CLOSURE:
+                call_closure((LoxClosure *)callable, num_arguments, line);
+                return;
+        case LOX_CALLABLE_FUNCTION:
+                errx(EXIT_FAILURE, "unexpected callable");
+        }
+}
+
+static Upvalue *capture_upvalue(Object **local) {
+        Upvalue *previous = NULL;
+        Upvalue *upvalue = vm.open_upvalues;
+        while (upvalue != NULL && upvalue->location > local) {
+                previous = upvalue;
+                upvalue = upvalue->next;
+        }
+        if (upvalue != NULL && upvalue->location == local) {
+                return upvalue;
+        }
+
+        Upvalue *created = upvalue_construct(local);
+        created->next = upvalue;
+        if (previous == NULL) {
+                vm.open_upvalues = created;
+        } else {
+                previous->next = created;
+        }
+        return created;
+}
+
+static void close_upvalues(Object **last) {
+        while (vm.open_upvalues != NULL && vm.open_upvalues->location >= last) {
+                Upvalue *upvalue = vm.open_upvalues;
+                upvalue->closed = *upvalue->location;
+                upvalue->location = &upvalue->closed;
+                vm.open_upvalues = upvalue->next;
+        }
+}
+
+static void run(void) {
+        CallFrame *frame = &vm.frames[vm.num_frames - 1];
+        uint8_t *ip = frame->ip;
+
+#define READ_BYTE() (*ip++)
+#define READ_U16() (ip += 2, (uint16_t)(ip[-2] | ip[-1] << 8))
+#define READ_U32() (ip += 4, (uint32_t)ip[-4] | (uint32_t)ip[-3] << 8 | (uint32_t)ip[-2] << 16 | (uint32_t)ip[-1] << 24)
+#define READ_CONSTANT() ((Object *)vector_at(frame->closure->prototype->chunk.constants, READ_U32()))
+#define READ_STRING() object_as_string(READ_CONSTANT())
+#define LINE() (frame->closure->prototype->chunk.lines[ip - frame->closure->prototype->chunk.code - 1])
+#define NUMBER_OPERANDS(left, right) \
+        do { \
+                right = peek(0); \
+                left = peek(1); \
+                if (!object_is_number(left) || !object_is_number(right)) { \
+                        vm_error(LINE(), "Operands must be numbers."); \
+                } \
+        } while (false)
+#ifdef LOX_JIT
+#define ENTER_NATIVE() \
+        do { \
+                const JitCode *jit_code = frame->closure->prototype->jit_code; \
+                if (jit_code != NULL) { \
+                        frame->ip = ip; \
+                        jit_execute(jit_code, frame, &vm.stack_top); \
+                        ip = frame->ip; \
+                } \
+        } while (false)
+#else
+#define ENTER_NATIVE() do { } while (false)
+#endif
+#define BINARY_OP(construct, op) \
+        do { \
+                Object *left, *right; \
+                NUMBER_OPERANDS(left, right); \
+                vm.stack_top--; \
+                vm.stack_top[-1] = construct(object_as_number(left) op object_as_number(right)); \
+        } while (false)
+
+#ifdef LOX_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+        static void *dispatch_table[UINT8_MAX + 1] = {
+                [0 ... UINT8_MAX] = &&CASE_UNKNOWN,
+                [OP_ADD] = &&CASE_OP_ADD,
+                [OP_CALL] = &&CASE_OP_CALL,
+                [OP_CHECK_INSTANCE] = &&CASE_OP_CHECK_INSTANCE,
+                [OP_CLASS] = &&CASE_OP_CLASS,
+                [OP_CLOSE_UPVALUE] = &&CASE_OP_CLOSE_UPVALUE,
+                [OP_CLOSURE] = &&CASE_OP_CLOSURE,
+                [OP_CONSTANT] = &&CASE_OP_CONSTANT,
+                [OP_DEFINE_GLOBAL] = &&CASE_OP_DEFINE_GLOBAL,
+                [OP_DIVIDE] = &&CASE_OP_DIVIDE,
+                [OP_EQUAL] = &&CASE_OP_EQUAL,
+                [OP_FALSE] = &&CASE_OP_FALSE,
+                [OP_GET_GLOBAL] = &&CASE_OP_GET_GLOBAL,
+                [OP_GET_LOCAL] = &&CASE_OP_GET_LOCAL,
+                [OP_GET_PROPERTY] = &&CASE_OP_GET_PROPERTY,
+                [OP_GET_SUPER] = &&CASE_OP_GET_SUPER,
+                [OP_GET_UPVALUE] = &&CASE_OP_GET_UPVALUE,
+                [OP_GREATER] = &&CASE_OP_GREATER,
+                [OP_GREATER_EQUAL] = &&CASE_OP_GREATER_EQUAL,
+                [OP_INHERIT] = &&CASE_OP_INHERIT,
+                [OP_JUMP] = &&CASE_OP_JUMP,
+                [OP_JUMP_IF_FALSE] = &&CASE_OP_JUMP_IF_FALSE,
+                [OP_JUMP_IF_TRUE] = &&CASE_OP_JUMP_IF_TRUE,
+                [OP_LESS] = &&CASE_OP_LESS,
+                [OP_LESS_EQUAL] = &&CASE_OP_LESS_EQUAL,
+                [OP_LOOP] = &&CASE_OP_LOOP,
+                [OP_METHOD] = &&CASE_OP_METHOD,
+                [OP_MULTIPLY] = &&CASE_OP_MULTIPLY,
+                [OP_NEGATE] = &&CASE_OP_NEGATE,
+                [OP_NIL] = &&CASE_OP_NIL,
+                [OP_NOT] = &&CASE_OP_NOT,
+                [OP_NOT_EQUAL] = &&CASE_OP_NOT_EQUAL,
+                [OP_POP] = &&CASE_OP_POP,
+                [OP_POP_JUMP_IF_FALSE] = &&CASE_OP_POP_JUMP_IF_FALSE,
+                [OP_PRINT] = &&CASE_OP_PRINT,
+                [OP_RETURN] = &&CASE_OP_RETURN,
+                [OP_SET_GLOBAL] = &&CASE_OP_SET_GLOBAL,
+                [OP_SET_LOCAL] = &&CASE_OP_SET_LOCAL,
+                [OP_SET_PROPERTY] = &&CASE_OP_SET_PROPERTY,
+                [OP_SET_UPVALUE] = &&CASE_OP_SET_UPVALUE,
+                [OP_SUBTRACT] = &&CASE_OP_SUBTRACT,
+                [OP_TRUE] = &&CASE_OP_TRUE,
+        };
+#pragma GCC diagnostic pop
+#define CASE(opcode) case opcode: CASE_##opcode
+#define NEXT() goto *dispatch_table[READ_BYTE()]
+#else
+#define CASE(opcode) case opcode
+#define NEXT() continue
+#endif
+
+        ENTER_NATIVE();
+        for ( ; ; ) {
+                switch (READ_BYTE()) {
+                CASE(OP_ADD): {
+                        Object *right = peek(0);
+                        Object *left = peek(1);
+                        Object *result;
+                        if (object_is_string(left) && object_is_string(right)) {
+                                result = string_object_concat(left, right);
+                        } else if (object_is_number(left) && object_is_number(right)) {
+                                result = number_object_construct(object_as_number(left) + object_as_number(right));
+                        } else {
+                                vm_error(LINE(), "Operands must be two numbers or two strings.");
+                        }
+                        vm.stack_top--;
+                        vm.stack_top[-1] = result;
+                        NEXT();
+                }
+                CASE(OP_CALL): {
+                        size_t num_arguments = READ_BYTE();
+                        frame->ip = ip;
+                        gc_maybe_collect();
+                        call_value(peek(num_arguments), num_arguments, LINE());
+                        frame = &vm.frames[vm.num_frames - 1];
+                        ip = frame->ip;
+                        ENTER_NATIVE();
+                        NEXT();
+                }
+                CASE(OP_CHECK_INSTANCE):
+                        if (!object_is_lox_instance(peek(0))) {
+                                vm_error(LINE(), "Only instances have fields.");
+                        }
+                        NEXT();
+                CASE(OP_CLASS): {
+                        LoxClass *class = lox_class_construct(READ_STRING(), NULL, map_construct(ptr_hash, ptr_compare));
+                        push(lox_callable_object_construct((LoxCallable *)class));
+                        NEXT();
+                }
+                CASE(OP_CLOSE_UPVALUE):
+                        close_upvalues(vm.stack_top - 1);
+                        pop();
+                        NEXT();
+                CASE(OP_CLOSURE): {
+                        Prototype *prototype = vector_at(frame->closure->prototype->chunk.prototypes, READ_U32());
+                        LoxClosure *closure = lox_closure_construct(prototype);
+                        push(lox_callable_object_construct((LoxCallable *)closure));
+                        for (size_t i = 0; i < prototype->num_upvalues; i++) {
+                                bool is_local = READ_BYTE();
+                                uint16_t index = READ_U16();
+                                if (is_local) {
+                                        closure->upvalues[i] = capture_upvalue(frame->slots + index);
+                                } else {
+                                        closure->upvalues[i] = frame->closure->upvalues[index];
+                                }
+                        }
+                        NEXT();
+                }
+                CASE(OP_CONSTANT):
+                        push(READ_CONSTANT());
+                        NEXT();
+                CASE(OP_DEFINE_GLOBAL):
+                        map_put(vm.globals, READ_STRING(), pop());
+                        NEXT();
+                CASE(OP_DIVIDE):
+                        BINARY_OP(number_object_construct, /);
+                        NEXT();
+                CASE(OP_EQUAL): {
+                        Object *right = pop();
+                        vm.stack_top[-1] = boolean_object_construct(object_equals(peek(0), right));
+                        NEXT();
+                }
+                CASE(OP_FALSE):
+                        push(boolean_object_construct(false));
+                        NEXT();
+                CASE(OP_GET_GLOBAL): {
+                        const char *name = READ_STRING();
+                        void *value;
+                        if (!map_find(vm.globals, name, &value)) {
+                                vm_error(LINE(), "Undefined variable '%s'.", name);
+                        }
+                        push(value);
+                        NEXT();
+                }
+                CASE(OP_GET_LOCAL):
+                        push(frame->slots[READ_U16()]);
+                        NEXT();
+                CASE(OP_GET_PROPERTY): {
+                        const char *name = READ_STRING();
+                        Object *object = peek(0);
+                        if (!object_is_lox_instance(object)) {
+                                vm_error(LINE(), "Only instances have properties.");
+                        }
+                        LoxInstance *instance = object_as_lox_instance(object);
+                        Object *value;
+                        if (lox_instance_find_field(instance, name, &value)) {
+                                vm.stack_top[-1] = value;
+                                NEXT();
+                        }
+                        LoxClosure *method = find_method(instance->class, name);
+                        if (method == NULL) {
+                                vm_error(LINE(), "Undefined property '%s'.", name);
+                        }
+                        LoxBoundMethod *bound_method = lox_bound_method_construct(object, method);
+                        vm.stack_top[-1] = lox_callable_object_construct((LoxCallable *)bound_method);
+                        NEXT();
+                }
+                CASE(OP_GET_SUPER): {
+                        const char *name = READ_STRING();
+                        LoxClass *superclass = (LoxClass *)object_as_lox_callable(pop());
+                        LoxClosure *method = find_method(superclass, name);
+                        if (method == NULL) {
+                                vm_error(LINE(), "Undefined property '%s'.", name);
+                        }
+                        LoxBoundMethod *bound_method = lox_bound_method_construct(peek(0), method);
+                        vm.stack_top[-1] = lox_callable_object_construct((LoxCallable *)bound_method);
+                        NEXT();
+                }
+                CASE(OP_GET_UPVALUE):
+                        push(*frame->closure->upvalues[READ_U16()]->location);
+                        NEXT();
+                CASE(OP_GREATER):
+                        BINARY_OP(boolean_object_construct, >);
+                        NEXT();
+                CASE(OP_GREATER_EQUAL):
+                        BINARY_OP(boolean_object_construct, >=);
+                        NEXT();
+                CASE(OP_INHERIT): {
+                        Object *superclass = peek(1);
+                        if (!object_is_lox_callable(superclass) || object_as_lox_callable(superclass)->type != LOX_CALLABLE_CLASS) {
+                                vm_error(LINE(), "Superclass must be a class.");
+                        }
+                        LoxClass *subclass = (LoxClass *)object_as_lox_callable(pop());
+                        subclass->superclass = (LoxClass *)object_as_lox_callable(superclass);
+                        map_put_all(subclass->methods, subclass->superclass->methods);
+                        subclass->initializer = subclass->superclass->initializer;
+                        NEXT();
+                }
+                CASE(OP_JUMP): {
+                        uint32_t offset = READ_U32();
+                        ip += offset;
+                        NEXT();
+                }
+                CASE(OP_JUMP_IF_FALSE): {
+                        uint32_t offset = READ_U32();
+                        if (!object_is_truthy(peek(0))) {
+                                ip += offset;
+                        }
+                        NEXT();
+                }
+                CASE(OP_JUMP_IF_TRUE): {
+                        uint32_t offset = READ_U32();
+                        if (object_is_truthy(peek(0))) {
+                                ip += offset;
+                        }
+                        NEXT();
+                }
+                CASE(OP_LESS):
+                        BINARY_OP(boolean_object_construct, <);
+                        NEXT();
+                CASE(OP_LESS_EQUAL):
+                        BINARY_OP(boolean_object_construct, <=);
+                        NEXT();
+                CASE(OP_LOOP): {
+                        uint32_t offset = READ_U32();
+                        ip -= offset;
+                        gc_maybe_collect();
+                        warm_up(frame->closure->prototype);
+                        ENTER_NATIVE();
+                        NEXT();
+                }
+                CASE(OP_METHOD): {
+                        const char *name = READ_STRING();
+                        LoxClass *class = (LoxClass *)object_as_lox_callable(peek(1));
+                        LoxCallable *method = object_as_lox_callable(pop());
+                        map_put(class->methods, name, method);
+                        if (name == intern_string("init")) {
+                                class->initializer = method;
+                        }
+                        NEXT();
+                }
+                CASE(OP_MULTIPLY):
+                        BINARY_OP(number_object_construct, *);
+                        NEXT();
+                CASE(OP_NEGATE):
+                        if (!object_is_number(peek(0))) {
+                                vm_error(LINE(), "Operand must be a number.");
+                        }
+                        vm.stack_top[-1] = number_object_construct(-object_as_number(peek(0)));
+                        NEXT();
+                CASE(OP_NIL):
+                        push(nil_object_construct());
+                        NEXT();
+                CASE(OP_NOT):
+                        vm.stack_top[-1] = boolean_object_construct(!object_is_truthy(peek(0)));
+                        NEXT();
+                CASE(OP_NOT_EQUAL): {
+                        Object *right = pop();
+                        vm.stack_top[-1] = boolean_object_construct(!object_equals(peek(0), right));
+                        NEXT();
+                }
+                CASE(OP_POP):
+                        pop();
+                        NEXT();
+                CASE(OP_POP_JUMP_IF_FALSE): {
+                        uint32_t offset = READ_U32();
+                        if (!object_is_truthy(pop())) {
+                                ip += offset;
+                        }
+                        NEXT();
+                }
+                CASE(OP_PRINT):
+                        printf("%s\n", object_stringify(pop()));
+                        NEXT();
+                CASE(OP_RETURN): {
+                        Object *result = pop();
+                        close_upvalues(frame->slots);
+                        vm.num_frames--;
+                        if (vm.num_frames == 0) {
+                                vm.stack_top = vm.stack;
+                                return;
+                        }
+                        vm.stack_top = frame->slots;
+                        push(result);
+                        frame = &vm.frames[vm.num_frames - 1];
+                        ip = frame->ip;
+                        ENTER_NATIVE();
+                        NEXT();
+                }
+                CASE(OP_SET_GLOBAL): {
+                        const char *name = READ_STRING();
+                        if (!map_contains(vm.globals, name)) {
+                                vm_error(LINE(), "Undefined variable '%s'.", name);
+                        }
+                        map_put(vm.globals, name, peek(0));
+                        NEXT();
+                }
+                CASE(OP_SET_LOCAL):
+                        frame->slots[READ_U16()] = peek(0);
+                        NEXT();
+                CASE(OP_SET_PROPERTY): {
+                        const char *name = READ_STRING();
+                        if (!object_is_lox_instance(peek(1))) {
+                                vm_error(LINE(), "Only instances have fields.");
+                        }
+                        LoxInstance *instance = object_as_lox_instance(peek(1));
+                        lox_instance_set_field(instance, name, peek(0));
+                        Object *value = pop();
+                        vm.stack_top[-1] = value;
+                        NEXT();
+                }
+                CASE(OP_SET_UPVALUE):
+                        *frame->closure->upvalues[READ_U16()]->location = peek(0);
+                        NEXT();
+                CASE(OP_SUBTRACT):
+                        BINARY_OP(number_object_construct, -);
+                        NEXT();
+                CASE(OP_TRUE):
+                        push(boolean_object_construct(true));
+                        NEXT();
+                default:
+#ifdef LOX_COMPUTED_GOTO
+                CASE_UNKNOWN:
+#endif
+                        errx(EXIT_FAILURE, "unexpected opcode");
+                }
+        }
+
+#undef READ_BYTE
+#undef READ_U16
+#undef READ_U32
+#undef READ_CONSTANT
+#undef READ_STRING
+#undef LINE
+#undef NUMBER_OPERANDS
+#undef BINARY_OP
+#undef ENTER_NATIVE
+#undef CASE
+#undef NEXT
+}
+
+void vm_interpret(Prototype *script) {
+        init();
+        LoxClosure *closure = lox_closure_construct(script);
+        push(lox_callable_object_construct((LoxCallable *)closure));
+        call_closure(closure, 0, 0);
+        run();
+}
+
+void vm_disable_jit(void) {
+        vm.is_jit_disabled = true;
+}
+
+void vm_set_jit_threshold(size_t threshold) {
+        vm.jit_threshold = threshold;
+}
@@ -0,0 +1,21 @@
+#ifndef CODECRAFTERS_INTERPRETER_LOX_VM_H
+#define CODECRAFTERS_INTERPRETER_LOX_VM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lox/chunk.h"
+#include "lox/lox_closure.h"
+#include "lox/object.h"
+
+typedef struct {
+        LoxClosure *closure;
+        uint8_t *ip;
+        Object **slots;
+} CallFrame;
+
+void vm_interpret(Prototype *script);
+void vm_disable_jit(void);
+void vm_set_jit_threshold(size_t threshold);
+
+#endif
@@ -1,43 +1,92 @@
 #include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "lox/ast.h"
 #include "lox/ast_printer.h"
+#include "lox/compiler.h"
+#include "lox/gc.h"
 #include "lox/interpreter.h"
+#include "lox/optimizer.h"
 #include "lox/parser.h"
 #include "lox/resolver.h"
 #include "lox/scanner.h"
 #include "lox/token.h"
-#include "util/vector.h"
+#include "lox/vm.h"
+#include "util/arena.h"
 #include "util/xmalloc.h"
 
-static char *read_source(const char *path) {
-        FILE *file = fopen(path, "r");
-        if (file == NULL) {
+static char *map_source(int fd, size_t num_chars, const char *path) {
+        size_t page_size = sysconf(_SC_PAGESIZE);
+        size_t length = (num_chars / page_size + 1) * page_size;
+        char *source = mmap(NULL, length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (source == MAP_FAILED) {
                 err(EXIT_FAILURE, "%s", path);
         }
+        if (num_chars > 0 && mmap(source, num_chars, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+                err(EXIT_FAILURE, "%s", path);
+        }
+        return source;
+}
 
-        fseek(file, 0, SEEK_END);
-        size_t num_chars = ftell(file);
-        fseek(file, 0, SEEK_SET);
-
-        char *source = xmalloc(num_chars + 1);
-        fread(source, 1, num_chars, file);
+static char *read_stream(int fd, const char *path) {
+        size_t capacity = 4096;
+        size_t num_chars = 0;
+        char *source = xmalloc(capacity);
+        while (true) {
+                if (num_chars + 1 == capacity) {
+                        capacity *= 2;
+                        source = xrealloc(source, capacity);
+                }
+                ssize_t num_read = read(fd, source + num_chars, capacity - num_chars - 1);
+                if (num_read == 0) {
+                        break;
+                } else if (num_read < 0) {
+                        if (errno == EINTR) {
+                                continue;
+                        }
+                        err(EXIT_FAILURE, "%s", path);
+                }
+                num_chars += num_read;
+        }
         source[num_chars] = '\0';
-
-        fclose(file);
         return source;
 }
 
-static void tokenize(const char *source) {
-        Vector *tokens = scan_tokens(source);
+static const char *read_source(const char *path) {
+        int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+        if (fd < 0) {
+                err(EXIT_FAILURE, "%s", path);
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+                err(EXIT_FAILURE, "%s", path);
+        }
+        char *source = S_ISREG(st.st_mode) ? map_source(fd, st.st_size, path) : read_stream(fd, path);
 
-        size_t num_tokens = vector_size(tokens);
-        for (size_t i = 0; i < num_tokens; i++) {
-                Token *token = vector_at(tokens, i);
-                printf("%s\n", token_to_string(token));
+        if (fd != STDIN_FILENO) {
+                close(fd);
         }
+        return source;
+}
+
+static void tokenize(const char *source) {
+        setvbuf(stdout, NULL, _IOFBF, 1 << 20);
+        scanner_init(source);
+        Token token;
+        do {
+                scanner_next(&token);
+                fputs(token_to_string(&token), stdout);
+                putchar('\n');
+        } while (token.type != TOKEN_EOF);
 
         if (has_scan_error()) {
                 exit(65);
@@ -45,38 +94,83 @@ static void tokenize(const char *source) {
 }
 
 static void parse(const char *source) {
-        Vector *tokens = scan_tokens(source);
+        Expr *expr = parse_expr(source);
         if (has_scan_error()) {
                 exit(65);
         }
-        println_expr(parse_expr(tokens));
+        println_expr(expr);
 }
 
 static void evaluate(const char *source) {
-        Vector *tokens = scan_tokens(source);
+        Expr *expr = parse_expr(source);
         if (has_scan_error()) {
                 exit(65);
         }
-        interpret_expr(parse_expr(tokens));
+        interpret_expr(expr);
 }
 
-static void run(const char *source) {
-        Vector *tokens = scan_tokens(source);
+static void run(const char *source, bool use_vm, bool specialize, bool optimize) {
+        AstList statements = parse_stmts(source);
         if (has_scan_error()) {
                 exit(65);
         }
-        Vector *statements = parse_stmts(tokens);
         resolve_stmts(statements);
-        interpret_stmts(statements);
+        if (optimize) {
+                statements = optimize_stmts(statements);
+        }
+        if (use_vm) {
+                vm_interpret(compile_stmts(statements));
+        } else {
+                if (specialize) {
+                        specialize_stmts(statements);
+                }
+                interpret_stmts(statements);
+        }
 }
 
 int main(int argc, char *argv[]) {
-        if (argc != 3) {
-                fprintf(stderr, "usage: %s command file\n", argv[0]);
+        if (argc < 3) {
+                fprintf(stderr, "usage: %s command [--vm] [--no-jit] [--jit-threshold=count] [--specialize] [--no-optimize] [--arena-stats] [--gc-stats] [--gc-growth=factor] file\n", argv[0]);
                 exit(EXIT_FAILURE);
         }
 
-        char *source = read_source(argv[2]);
+        bool use_vm = false;
+        bool specialize = false;
+        bool optimize = true;
+        for (int i = 2; i < argc - 1; i++) {
+                if (strcmp(argv[i], "--vm") == 0) {
+                        use_vm = true;
+                } else if (strcmp(argv[i], "--no-jit") == 0) {
+                        vm_disable_jit();
+                } else if (strncmp(argv[i], "--jit-threshold=", strlen("--jit-threshold=")) == 0) {
+                        char *end;
+                        unsigned long long threshold = strtoull(argv[i] + strlen("--jit-threshold="), &end, 10);
+                        if (*end != '\0' || argv[i][strlen("--jit-threshold=")] == '\0') {
+                                errx(EXIT_FAILURE, "invalid jit threshold: %s", argv[i]);
+                        }
+                        vm_set_jit_threshold(threshold);
+                } else if (strcmp(argv[i], "--specialize") == 0) {
+                        specialize = true;
+                } else if (strcmp(argv[i], "--no-optimize") == 0) {
+                        optimize = false;
+                } else if (strcmp(argv[i], "--arena-stats") == 0) {
+                        arena_enable_stats();
+                        ast_enable_stats();
+                } else if (strcmp(argv[i], "--gc-stats") == 0) {
+                        gc_enable_stats();
+                } else if (strncmp(argv[i], "--gc-growth=", strlen("--gc-growth=")) == 0) {
+                        char *end;
+                        double growth_factor = strtod(argv[i] + strlen("--gc-growth="), &end);
+                        if (*end != '\0' || !(growth_factor > 1)) {
+                                errx(EXIT_FAILURE, "invalid gc growth factor: %s", argv[i]);
+                        }
+                        gc_set_growth_factor(growth_factor);
+                } else {
+                        errx(EXIT_FAILURE, "unknown option: %s", argv[i]);
+                }
+        }
+
+        const char *source = read_source(argv[argc - 1]);
 
         const char *command = argv[1];
         if (strcmp(command, "tokenize") == 0) {
@@ -86,10 +180,11 @@ int main(int argc, char *argv[]) {
         } else if (strcmp(command, "evaluate") == 0) {
                 evaluate(source);
         } else if (strcmp(command, "run") == 0) {
-                run(source);
+                run(source, use_vm, specialize, optimize);
         } else {
                 errx(EXIT_FAILURE, "unknown command: %s", command);
         }
 
+        arena_release();
         exit(EXIT_SUCCESS);
 }
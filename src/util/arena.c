@@ -0,0 +1,74 @@
+#include "util/arena.h"
+#include "util/xmalloc.h"
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ALIGNMENT 8
+#define BLOCK_SIZE (64 * 1024)
+
+typedef struct Block Block;
+struct Block {
+        Block *next;
+        alignas(max_align_t) char data[];
+};
+
+static struct {
+        Block *blocks;
+        char *current;
+        char *end;
+        size_t num_allocations;
+        size_t bytes_allocated;
+        size_t num_blocks;
+        size_t bytes_reserved;
+} arena;
+
+static Block *add_block(size_t size) {
+        Block *block = xmalloc(sizeof(Block) + size);
+        arena.num_blocks++;
+        arena.bytes_reserved += size;
+        block->next = arena.blocks;
+        arena.blocks = block;
+        return block;
+}
+
+void *arena_allocate(size_t size) {
+        size = (size + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+        arena.num_allocations++;
+        arena.bytes_allocated += size;
+
+        if (size > BLOCK_SIZE / 4) {
+                return add_block(size)->data;
+        }
+        if (size > (size_t)(arena.end - arena.current)) {
+                Block *block = add_block(BLOCK_SIZE);
+                arena.current = block->data;
+                arena.end = block->data + BLOCK_SIZE;
+        }
+        void *pointer = arena.current;
+        arena.current += size;
+        return pointer;
+}
+
+void arena_release(void) {
+        while (arena.blocks != NULL) {
+                Block *next = arena.blocks->next;
+                free(arena.blocks);
+                arena.blocks = next;
+        }
+        arena.current = NULL;
+        arena.end = NULL;
+}
+
+static void report_stats(void) {
+        fprintf(stderr, "[arena] allocations: %zu\n", arena.num_allocations);
+        fprintf(stderr, "[arena] bytes allocated: %zu\n", arena.bytes_allocated);
+        fprintf(stderr, "[arena] blocks: %zu\n", arena.num_blocks);
+        fprintf(stderr, "[arena] bytes reserved: %zu\n", arena.bytes_reserved);
+}
+
+void arena_enable_stats(void) {
+        atexit(report_stats);
+}
@@ -0,0 +1,10 @@
+#ifndef CODECRAFTERS_INTERPRETER_UTIL_ARENA_H
+#define CODECRAFTERS_INTERPRETER_UTIL_ARENA_H
+
+#include <stddef.h>
+
+void *arena_allocate(size_t size);
+void arena_release(void);
+void arena_enable_stats(void);
+
+#endif
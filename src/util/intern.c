@@ -0,0 +1,79 @@
+#include "util/intern.h"
+#include "util/xmalloc.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+        const char *string;
+        size_t length;
+        uint64_t hash;
+} Entry;
+
+static struct {
+        Entry *entries;
+        size_t capacity;
+        size_t size;
+} table;
+
+static uint64_t hash_chars(const char *chars, size_t length) {
+        uint64_t hash = 14695981039346656037u;
+        for (size_t i = 0; i < length; i++) {
+                hash ^= (unsigned char)chars[i];
+                hash *= 1099511628211u;
+        }
+        return hash;
+}
+
+static Entry *find_entry(Entry *entries, size_t capacity, const char *chars, size_t length, uint64_t hash) {
+        size_t mask = capacity - 1;
+        for (size_t index = hash & mask; ; index = (index + 1) & mask) {
+                Entry *entry = &entries[index];
+                if (entry->string == NULL) {
+                        return entry;
+                }
+                if (entry->hash == hash && entry->length == length && memcmp(entry->string, chars, length) == 0) {
+                        return entry;
+                }
+        }
+}
+
+static void grow(void) {
+        size_t new_capacity = table.capacity == 0 ? 256 : table.capacity * 2;
+        Entry *new_entries = xmalloc(sizeof(Entry) * new_capacity);
+        for (size_t i = 0; i < new_capacity; i++) {
+                new_entries[i].string = NULL;
+        }
+
+        for (size_t i = 0; i < table.capacity; i++) {
+                Entry *entry = &table.entries[i];
+                if (entry->string != NULL) {
+                        *find_entry(new_entries, new_capacity, entry->string, entry->length, entry->hash) = *entry;
+                }
+        }
+
+        free(table.entries);
+        table.entries = new_entries;
+        table.capacity = new_capacity;
+}
+
+const char *intern(const char *chars, size_t length) {
+        if ((table.size + 1) * 4 > table.capacity * 3) {
+                grow();
+        }
+
+        uint64_t hash = hash_chars(chars, length);
+        Entry *entry = find_entry(table.entries, table.capacity, chars, length, hash);
+        if (entry->string == NULL) {
+                entry->string = xstrndup(chars, length);
+                entry->length = length;
+                entry->hash = hash;
+                table.size++;
+        }
+        return entry->string;
+}
+
+const char *intern_string(const char *string) {
+        return intern(string, strlen(string));
+}
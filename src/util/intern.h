@@ -0,0 +1,9 @@
+#ifndef CODECRAFTERS_INTERPRETER_UTIL_INTERN_H
+#define CODECRAFTERS_INTERPRETER_UTIL_INTERN_H
+
+#include <stddef.h>
+
+const char *intern(const char *chars, size_t length);
+const char *intern_string(const char *string);
+
+#endif
@@ -1,105 +1,179 @@
 #include "util/map.h"
 #include "util/xmalloc.h"
 
-#include <assert.h>
+#include <err.h>
+#include <stdlib.h>
 
-typedef struct Node Node;
-struct Node {
+typedef struct {
         const void *key;
         void *value;
-        size_t level;
-        Node *lch;
-        Node *rch;
+        uint64_t hash;
+} Entry;
+
+struct Map {
+        Entry *entries;
+        size_t capacity;
+        size_t size;
+        Hasher hasher;
+        Comparator comparator;
 };
 
-static Node *node_construct(const void *key, void *value) {
-        Node *node = xmalloc(sizeof(Node));
-        node->key = key;
-        node->value = value;
-        node->level = 1;
-        node->lch = NULL;
-        node->rch = NULL;
-        return node;
+static uint64_t normalize(uint64_t hash) {
+        return hash == 0 ? 1 : hash;
 }
 
-static void skew(Node **rootp) {
-        Node *root = *rootp;
-        if (root == NULL || root->lch == NULL || root->level != root->lch->level) {
-                return;
+static Entry *find_entry(Entry *entries, size_t capacity, const void *key, uint64_t hash, Comparator comparator) {
+        size_t mask = capacity - 1;
+        for (size_t index = hash & mask; ; index = (index + 1) & mask) {
+                Entry *entry = &entries[index];
+                if (entry->hash == 0) {
+                        return entry;
+                }
+                if (entry->hash == hash && comparator(key, entry->key) == 0) {
+                        return entry;
+                }
         }
-        Node *lch = root->lch;
-        root->lch = lch->rch;
-        lch->rch = root;
-        *rootp = lch;
 }
 
-static void split(Node **rootp) {
-        Node *root = *rootp;
-        if (root == NULL || root->rch == NULL || root->rch->rch == NULL || root->level != root->rch->rch->level) {
-                return;
+static void grow(Map *map) {
+        size_t new_capacity = map->capacity == 0 ? 8 : map->capacity * 2;
+        Entry *new_entries = xmalloc(sizeof(Entry) * new_capacity);
+        for (size_t i = 0; i < new_capacity; i++) {
+                new_entries[i].hash = 0;
         }
-        Node *rch = root->rch;
-        root->rch = rch->lch;
-        rch->lch = root;
-        rch->level++;
-        *rootp = rch;
-}
-
-static void insert(Node **rootp, const void *key, void *value, Comparator comparator) {
-        Node *root = *rootp;
-        if (root == NULL) {
-                *rootp = node_construct(key, value);
-                return;
+
+        size_t mask = new_capacity - 1;
+        for (size_t i = 0; i < map->capacity; i++) {
+                Entry *entry = &map->entries[i];
+                if (entry->hash == 0) {
+                        continue;
+                }
+                size_t index = entry->hash & mask;
+                while (new_entries[index].hash != 0) {
+                        index = (index + 1) & mask;
+                }
+                new_entries[index] = *entry;
         }
 
-        int c = comparator(key, root->key);
-        if (c < 0) {
-                insert(&root->lch, key, value, comparator);
-        } else if (c > 0) {
-                insert(&root->rch, key, value, comparator);
-        } else {
-                root->value = value;
+        free(map->entries);
+        map->entries = new_entries;
+        map->capacity = new_capacity;
+}
+
+Map *map_construct(Hasher hasher, Comparator comparator) {
+        Map *map = xmalloc(sizeof(Map));
+        map->entries = NULL;
+        map->capacity = 0;
+        map->size = 0;
+        map->hasher = hasher;
+        map->comparator = comparator;
+        return map;
+}
+
+void map_destruct(Map *map) {
+        free(map->entries);
+        free(map);
+}
+
+size_t map_size(const Map *map) {
+        return map->size;
+}
+
+void map_put(Map *map, const void *key, void *value) {
+        map_put_hashed(map, key, map->hasher(key), value);
+}
+
+bool map_contains(const Map *map, const void *key) {
+        return map_contains_hashed(map, key, map->hasher(key));
+}
+
+void *map_get(Map *map, const void *key) {
+        return map_get_hashed(map, key, map->hasher(key));
+}
+
+bool map_find(const Map *map, const void *key, void **value) {
+        return map_find_hashed(map, key, map->hasher(key), value);
+}
+
+bool map_remove(Map *map, const void *key) {
+        if (map->size == 0) {
+                return false;
+        }
+
+        Entry *entry = find_entry(map->entries, map->capacity, key, normalize(map->hasher(key)), map->comparator);
+        if (entry->hash == 0) {
+                return false;
         }
 
-        skew(&root);
-        split(&root);
-        *rootp = root;
+        size_t mask = map->capacity - 1;
+        size_t hole = entry - map->entries;
+        for (size_t index = (hole + 1) & mask; map->entries[index].hash != 0; index = (index + 1) & mask) {
+                size_t home = map->entries[index].hash & mask;
+                if (((index - home) & mask) >= ((index - hole) & mask)) {
+                        map->entries[hole] = map->entries[index];
+                        hole = index;
+                }
+        }
+        map->entries[hole].hash = 0;
+        map->size--;
+        return true;
 }
 
-static Node *search(Node *root, const void *key, Comparator comparator) {
-        if (root == NULL) {
-                return NULL;
+void map_for_each(const Map *map, Visitor visitor) {
+        for (size_t i = 0; i < map->capacity; i++) {
+                Entry *entry = &map->entries[i];
+                if (entry->hash != 0) {
+                        visitor(entry->key, entry->value);
+                }
         }
+}
 
-        int c = comparator(key, root->key);
-        if (c == 0) {
-                return root;
+void map_put_all(Map *map, const Map *other) {
+        for (size_t i = 0; i < other->capacity; i++) {
+                Entry *entry = &other->entries[i];
+                if (entry->hash != 0) {
+                        map_put_hashed(map, entry->key, entry->hash, entry->value);
+                }
         }
-        return search(c < 0 ? root->lch : root->rch, key, comparator);
 }
 
-struct Map {
-        Node *root;
-        Comparator comparator;
-};
+void map_put_hashed(Map *map, const void *key, uint64_t hash, void *value) {
+        if (4 * (map->size + 1) > 3 * map->capacity) {
+                grow(map);
+        }
 
-Map *map_construct(Comparator comparator) {
-        Map *map = xmalloc(sizeof(Map));
-        map->root = NULL;
-        map->comparator = comparator;
-        return map;
+        hash = normalize(hash);
+        Entry *entry = find_entry(map->entries, map->capacity, key, hash, map->comparator);
+        if (entry->hash == 0) {
+                entry->key = key;
+                entry->hash = hash;
+                map->size++;
+        }
+        entry->value = value;
 }
 
-void map_put(Map *map, const void *key, void *value) {
-        insert(&map->root, key, value, map->comparator);
+bool map_contains_hashed(const Map *map, const void *key, uint64_t hash) {
+        void *value;
+        return map_find_hashed(map, key, hash, &value);
 }
 
-bool map_contains(const Map *map, const void *key) {
-        return search(map->root, key, map->comparator) != NULL;
+void *map_get_hashed(Map *map, const void *key, uint64_t hash) {
+        void *value;
+        if (!map_find_hashed(map, key, hash, &value)) {
+                errx(EXIT_FAILURE, "map_get: key not found");
+        }
+        return value;
 }
 
-void *map_get(Map *map, const void *key) {
-        Node *node = search(map->root, key, map->comparator);
-        assert(node != NULL);
-        return node->value;
+bool map_find_hashed(const Map *map, const void *key, uint64_t hash, void **value) {
+        if (map->size == 0) {
+                return false;
+        }
+
+        Entry *entry = find_entry(map->entries, map->capacity, key, normalize(hash), map->comparator);
+        if (entry->hash == 0) {
+                return false;
+        }
+        *value = entry->value;
+        return true;
 }
@@ -1,20 +1,53 @@
 #ifndef CODECRAFTERS_INTERPRETER_UTIL_MAP_H
 #define CODECRAFTERS_INTERPRETER_UTIL_MAP_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
 typedef struct Map Map;
+typedef uint64_t (*Hasher)(const void *);
 typedef int (*Comparator)(const void *, const void *);
+typedef void (*Visitor)(const void *, void *);
 
-Map *map_construct(Comparator comparator);
+Map *map_construct(Hasher hasher, Comparator comparator);
+void map_destruct(Map *map);
+size_t map_size(const Map *map);
 void map_put(Map *map, const void *key, void *value);
 bool map_contains(const Map *map, const void *key);
 void *map_get(Map *map, const void *key);
+bool map_find(const Map *map, const void *key, void **value);
+bool map_remove(Map *map, const void *key);
+void map_for_each(const Map *map, Visitor visitor);
+void map_put_all(Map *map, const Map *other);
+
+void map_put_hashed(Map *map, const void *key, uint64_t hash, void *value);
+bool map_contains_hashed(const Map *map, const void *key, uint64_t hash);
+void *map_get_hashed(Map *map, const void *key, uint64_t hash);
+bool map_find_hashed(const Map *map, const void *key, uint64_t hash, void **value);
+
+static inline uint64_t str_hash(const void *str) {
+        uint64_t hash = 14695981039346656037u;
+        for (const unsigned char *p = str; *p != '\0'; p++) {
+                hash ^= *p;
+                hash *= 1099511628211u;
+        }
+        return hash;
+}
 
 static inline int str_compare(const void *str1, const void *str2) {
         return strcmp(str1, str2);
 }
 
+static inline uint64_t ptr_hash(const void *ptr) {
+        uint64_t hash = (uintptr_t)ptr;
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdu;
+        hash ^= hash >> 33;
+        return hash;
+}
+
 static inline int ptr_compare(const void *ptr1, const void *ptr2) {
         if (ptr1 == ptr2) {
                 return 0;
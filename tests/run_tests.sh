@@ -0,0 +1,58 @@
+#!/bin/sh
+
+if [ $# -ne 1 ]; then
+        echo "usage: $0 interpreter" >&2
+        exit 1
+fi
+
+interpreter=$1
+tests=$(dirname "$0")
+stderr=$(mktemp)
+trap 'rm -f "$stderr"' EXIT
+
+passed=0
+failed=0
+
+run_test() {
+        test=$1
+        shift
+
+        expected_output=$(sed -n 's|.*// expect: ||p' "$test")
+        error=$(grep -n '// expect runtime error: ' "$test")
+        if [ -n "$error" ]; then
+                expected_error=$(printf '%s\n[line %s]' "${error#*// expect runtime error: }" "${error%%:*}")
+                expected_status=70
+        else
+                expected_error=
+                expected_status=0
+        fi
+
+        actual_output=$("$interpreter" run "$@" "$test" 2>"$stderr")
+        actual_status=$?
+        actual_error=$(cat "$stderr")
+
+        if [ "$actual_output" = "$expected_output" ] && [ "$actual_error" = "$expected_error" ] &&
+           [ "$actual_status" -eq "$expected_status" ]; then
+                passed=$((passed + 1))
+                return
+        fi
+
+        failed=$((failed + 1))
+        echo "FAIL: $test $*"
+        echo "expected status $expected_status, got $actual_status"
+        printf 'expected output:\n%s\ngot:\n%s\n' "$expected_output" "$actual_output"
+        printf 'expected error:\n%s\ngot:\n%s\n' "$expected_error" "$actual_error"
+}
+
+for test in "$tests"/*.lox; do
+        run_test "$test"
+        run_test "$test" --no-optimize
+        run_test "$test" --specialize
+        run_test "$test" --vm --no-jit
+        run_test "$test" --vm --no-optimize
+        run_test "$test" --vm
+        run_test "$test" --vm --jit-threshold=0
+done
+
+echo "$passed passed, $failed failed"
+[ "$failed" -eq 0 ]